@@ -0,0 +1,831 @@
+// Benchmarks: parse, serialize, lookup and round trip over a set of documents
+//
+// usage: xjson_bench [--format table|csv|json] [--data dir] [--filter text] [--min-time seconds]
+//                    [--label name] [--baseline results.json] [--threads n]
+//
+// the *.json files of the data directory are benchmarked when present (see bench/data/README.md),
+// the generated documents always are
+// every case reports the time per operation, the throughput over the input, the heap allocations per
+// operation and the peak resident memory of the process so far
+// save the json output of a commit and pass it as --baseline to another one to compare them
+// the parallel cases run on 1, 2, 4 .. --threads threads (the hardware threads by default), _t<n> in their name
+// the peak memory of one file case alone: --filter <corpus>/parse_file, then --filter <corpus>/read_parse
+
+#include <json.hpp>
+#include <json_bind.hpp>
+#include <json_file.hpp>
+#include <json_ondemand.hpp>
+#include <json_parallel.hpp>
+#include <json_shared.hpp>
+#include <json_tape.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if __has_include(<sys/resource.h>)
+#include <sys/resource.h>
+#define XJSON_RUSAGE
+#endif
+
+#ifndef XJSON_BENCH_DATA
+#define XJSON_BENCH_DATA "bench/data"
+#endif
+
+using namespace xihale::json;
+
+// every heap allocation of the process goes through these
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // free is the match of these malloc
+#endif
+static std::atomic<size_t> allocations{0};
+
+void *operator new(size_t n){
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if(auto p=std::malloc(n? n: 1)) return p;
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t n, std::align_val_t align){
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  auto a=std::max(size_t(align), sizeof(void *));
+  if(auto p=std::aligned_alloc(a, (std::max<size_t>(n, 1)+a-1)/a*a)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { ::operator delete(p); }
+void operator delete(void *p, std::align_val_t) noexcept { ::operator delete(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { ::operator delete(p); }
+
+// the typed view of the generated records, for the bind cases
+struct hashtag{
+  std::string text{};
+  std::vector<int> indices{};
+};
+XJSON_BIND(hashtag, text, indices);
+
+struct account{
+  long long id=0;
+  std::string name{}, screen_name{};
+  long long followers_count=0;
+  bool verified=false;
+  std::string description{};
+};
+XJSON_BIND(account, id, name, screen_name, followers_count, verified, description);
+
+struct status{
+  unsigned long long id=0;
+  std::string created_at{}, text{};
+  account user{};
+  std::map<std::string, std::vector<hashtag>> entities{};
+  std::optional<std::string> geo{};
+  long long retweet_count=0;
+  bool favorited=false;
+  std::string lang{};
+};
+XJSON_BIND(status, id, created_at, text, user, entities, geo, retweet_count, favorited, lang);
+
+struct timeline{
+  std::vector<status> statuses{};
+};
+XJSON_BIND(timeline, statuses);
+
+namespace{
+
+  using clock=std::chrono::steady_clock;
+
+  struct options{
+    std::string format="table";
+    std::string data=XJSON_BENCH_DATA;
+    std::string filter{};
+    std::string label{};
+    std::string baseline{};
+    double min_time=0.5;
+    size_t threads=std::max(1u, std::thread::hardware_concurrency());
+  };
+
+  struct corpus{
+    std::string name;
+    std::string text;
+  };
+
+  struct result{
+    std::string corpus, name;
+    size_t bytes; // input bytes per operation, 0 when the throughput means nothing
+    double ns; // per operation
+    double allocs; // per operation
+    long peak_rss_kb;
+  };
+
+  long peak_rss_kb(){
+#ifdef XJSON_RUSAGE
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage)==0) return usage.ru_maxrss;
+#endif
+    return 0;
+  }
+
+  // the median time of a run of op, in batches, until `min_time` is spent
+  // ops: operations done by one call of op
+  double measure(const std::function<void()> &op, size_t ops, double min_time){
+    op(); // warm up
+    size_t batch=1;
+    std::vector<double> times;
+    auto start=clock::now();
+    for(;;){
+      auto t0=clock::now();
+      for(size_t i=0;i<batch;++i) op();
+      double spent=std::chrono::duration<double>(clock::now()-t0).count();
+      // batches of at least 10 ms, so that the clock is not what is measured
+      if(spent<0.01 && times.empty()){
+        batch*=2;
+        continue;
+      }
+      times.push_back(spent/batch);
+      if(times.size()>=5 && std::chrono::duration<double>(clock::now()-start).count()>=min_time) break;
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size()/2]*1e9/ops;
+  }
+
+  double count_allocations(const std::function<void()> &op, size_t ops){
+    auto before=allocations.load(std::memory_order_relaxed);
+    op();
+    return double(allocations.load(std::memory_order_relaxed)-before)/ops;
+  }
+
+  // generated documents, the same ones on every run
+
+  struct generator{
+    std::mt19937_64 rng{42};
+
+    size_t uniform(size_t n){
+      return rng()%n;
+    }
+
+    std::string word(){
+      static const char *words[]={
+        "bad", "apple", "touhou", "shadow", "art", "remix", "cover", "live", "night", "flower",
+        "月", "東方", "音楽", "歌", "夜",
+      };
+      return words[uniform(std::size(words))];
+    }
+
+    std::string sentence(size_t n){
+      std::string res;
+      for(size_t i=0;i<n;++i){
+        if(i) res+=uniform(8)? " ": "\\n";
+        res+=word();
+      }
+      if(!uniform(4)) res+=" \\\"quoted\\\"";
+      return res;
+    }
+  };
+
+  // tweets: mostly strings, a few nested objects, ids and flags
+  std::string records(generator &g){
+    std::string out;
+    writer w(out);
+    w.start_object();
+    w.key("statuses");
+    w.start_array();
+    for(size_t i=0;i<2000;++i){
+      w.start_object();
+      w.key("id"), w.number(505874924095815681ull+i*7919);
+      w.key("created_at"), w.string("Sun Aug 31 00:29:15 +0000 2014");
+      w.key("text"), w.raw_string(g.sentence(8+g.uniform(12)));
+      w.key("user");
+      w.start_object();
+      w.key("id"), w.number(1186275104+g.uniform(1000000));
+      w.key("name"), w.raw_string(g.word()+" "+g.word());
+      w.key("screen_name"), w.string(std::format("user_{}", g.uniform(100000)));
+      w.key("followers_count"), w.number(g.uniform(100000));
+      w.key("verified"), w.boolean(!g.uniform(10));
+      w.key("description"), w.raw_string(g.sentence(10));
+      w.end_object();
+      w.key("entities");
+      w.start_object();
+      w.key("hashtags");
+      w.start_array();
+      for(size_t k=g.uniform(4);k;--k){
+        w.start_object();
+        w.key("text"), w.raw_string(g.word());
+        w.key("indices"), w.start_array(), w.number(g.uniform(100)), w.number(g.uniform(140)), w.end_array();
+        w.end_object();
+      }
+      w.end_array();
+      w.end_object();
+      w.key("geo"), w.null();
+      w.key("retweet_count"), w.number(g.uniform(5000));
+      w.key("favorited"), w.boolean(false);
+      w.key("lang"), w.string(g.uniform(2)? "ja": "en");
+      w.end_object();
+    }
+    w.end_array();
+    w.end_object();
+    return out;
+  }
+
+  // a polygon: arrays of coordinates, nothing but doubles
+  std::string coordinates(generator &g){
+    std::string out;
+    writer w(out);
+    w.start_object();
+    w.key("type"), w.string("FeatureCollection");
+    w.key("features");
+    w.start_array();
+    w.start_object();
+    w.key("type"), w.string("Feature");
+    w.key("geometry");
+    w.start_object();
+    w.key("type"), w.string("Polygon");
+    w.key("coordinates");
+    w.start_array();
+    for(size_t ring=0;ring<20;++ring){
+      w.start_array();
+      double lon=-141+g.uniform(80000)/1000.0, lat=41+g.uniform(40000)/1000.0;
+      for(size_t i=0;i<5000;++i){
+        lon+=(double(g.uniform(2001))-1000)/1e6;
+        lat+=(double(g.uniform(2001))-1000)/1e6;
+        w.start_array(), w.number(lon), w.number(lat), w.end_array();
+      }
+      w.end_array();
+    }
+    w.end_array();
+    w.end_object();
+    w.end_object();
+    w.end_array();
+    w.end_object();
+    return out;
+  }
+
+  // a catalog: objects keyed by numeric ids, the same few keys over and over, integers
+  std::string catalog(generator &g){
+    std::string out;
+    writer w(out);
+    w.start_object();
+    w.key("events");
+    w.start_object();
+    for(size_t i=0;i<3000;++i){
+      w.key(std::to_string(138586341+i*17));
+      w.start_object();
+      w.key("id"), w.number(138586341+i*17);
+      w.key("name"), w.raw_string(g.word()+" "+g.word());
+      w.key("logo"), g.uniform(3)? w.null(): w.string(std::format("/images/UE{:07}/{}.jpg", i, g.uniform(1000)));
+      w.key("subTopicIds");
+      w.start_array();
+      for(size_t k=1+g.uniform(4);k;--k) w.number(337184262+g.uniform(1000));
+      w.end_array();
+      w.key("topicIds"), w.start_array(), w.number(324846099+g.uniform(100)), w.end_array();
+      w.key("prices");
+      w.start_array();
+      for(size_t k=1+g.uniform(3);k;--k){
+        w.start_object();
+        w.key("amount"), w.number(9000+g.uniform(200)*500);
+        w.key("audienceSubCategoryId"), w.number(337100890);
+        w.key("seatCategoryId"), w.number(338937295+g.uniform(100));
+        w.end_object();
+      }
+      w.end_array();
+      w.end_object();
+    }
+    w.end_object();
+    w.end_object();
+    return out;
+  }
+
+  // nested 500 levels deep, objects and arrays in turn
+  std::string deep(generator &g){
+    std::string out;
+    writer w(out);
+    w.start_array();
+    for(size_t n=0;n<200;++n){
+      for(size_t d=0;d<500;++d){
+        if(d%2) w.start_array(), w.number(g.uniform(1000));
+        else w.start_object(), w.key("value"), w.number(g.uniform(1000)), w.key("next");
+      }
+      w.null();
+      for(size_t d=500;d--;) d%2? w.end_array(): w.end_object();
+    }
+    w.end_array();
+    return out;
+  }
+
+  // one object with 100k members
+  std::string wide(generator &g){
+    std::string out;
+    writer w(out);
+    w.start_object();
+    for(size_t i=0;i<100000;++i){
+      w.key(std::format("key_{:06}", i));
+      g.uniform(2)? w.number(g.uniform(1000000)): w.raw_string(g.word());
+    }
+    w.end_object();
+    return out;
+  }
+
+  std::vector<corpus> load(const options &opt){
+    std::vector<corpus> res;
+    std::error_code ec;
+    std::vector<std::filesystem::path> files;
+    for(auto &entry: std::filesystem::directory_iterator(opt.data, ec))
+      if(entry.path().extension()==".json") files.push_back(entry.path());
+    std::sort(files.begin(), files.end());
+    for(auto &file: files){
+      std::ifstream in(file, std::ios::binary);
+      std::stringstream ss;
+      ss<<in.rdbuf();
+      res.push_back({file.stem().string(), ss.str()});
+    }
+    generator g;
+    res.push_back({"gen_records", records(g)});
+    res.push_back({"gen_coordinates", coordinates(g)});
+    res.push_back({"gen_catalog", catalog(g)});
+    res.push_back({"gen_deep", deep(g)});
+    res.push_back({"gen_wide", wide(g)});
+    return res;
+  }
+
+  // a leaf of a document: its json pointer, and the same steps for operator[]
+  struct leaf{
+    std::string pointer{};
+    std::vector<std::pair<std::string, size_t>> steps{}; // a key, or an index when the key is empty
+  };
+
+  size_t count_leaves(const json &j){
+    size_t n=0;
+    if(j.is_object()) for(auto &[key, child]: j.get_const_object()) n+=key.size()? count_leaves(child): 0;
+    else if(j.is_array()) for(auto &child: j.get_const_array()) n+=count_leaves(child);
+    else n=1;
+    return n;
+  }
+
+  // every `stride`th leaf
+  void leaves(const json &j, leaf &cur, size_t &seen, size_t stride, std::vector<leaf> &out){
+    auto descend=[&](std::string key, size_t index){
+      auto size=cur.pointer.size();
+      cur.pointer+='/';
+      if(key.empty()) cur.pointer+=std::to_string(index);
+      for(auto ch: key) cur.pointer+=ch=='~'? "~0": ch=='/'? "~1": std::string(1, ch);
+      cur.steps.emplace_back(std::move(key), index);
+      return size;
+    };
+    auto ascend=[&](size_t size){
+      cur.pointer.resize(size);
+      cur.steps.pop_back();
+    };
+    if(j.is_object()){
+      for(auto &[key, child]: j.get_const_object()){
+        if(key.size()==0) continue; // unreachable by operator[] steps
+        auto size=descend(std::string(key.view()), 0);
+        leaves(child, cur, seen, stride, out);
+        ascend(size);
+      }
+    }else if(j.is_array()){
+      auto &arr=j.get_const_array();
+      for(size_t i=0;i<arr.size();++i){
+        auto size=descend({}, i);
+        leaves(arr[i], cur, seen, stride, out);
+        ascend(size);
+      }
+    }else if(seen++%stride==0) out.push_back(cur);
+  }
+
+  // at most n leaves, spread over the document
+  std::vector<leaf> sample(const json &root, size_t n){
+    std::vector<leaf> res;
+    leaf cur;
+    size_t seen=0;
+    leaves(root, cur, seen, std::max<size_t>(1, (count_leaves(root)+n-1)/n), res);
+    return res;
+  }
+
+  // the thread counts of the parallel cases: the powers of 2 up to max, and max
+  std::vector<size_t> sweep(size_t max){
+    std::vector<size_t> res;
+    for(size_t n=1;n<max;n*=2) res.push_back(n);
+    res.push_back(max);
+    return res;
+  }
+
+  // the corpus as ndjson: a line per element of its top level arrays, or the whole document 16 times
+  std::string lines(const json &root){
+    std::string res;
+    auto add=[&](const json &j){
+      res+=j.dump();
+      res+='\n';
+    };
+    if(root.is_array())
+      for(auto &j: root.get_const_array()) add(j);
+    else if(root.is_object())
+      for(auto &[key, j]: root.get_const_object())
+        if(j.is_array())
+          for(auto &e: j.get_const_array()) add(e);
+    if(res.empty())
+      for(int i=0;i<16;++i) add(root);
+    return res;
+  }
+
+  // the same records, the way it is done without binding: parse to a json, then copy every field out of it
+  timeline copy_timeline(const json &j){
+    timeline t;
+    for(auto &s: j["statuses"].get_const_array()){
+      auto &st=t.statuses.emplace_back();
+      st.id=s["id"];
+      st.created_at=s["created_at"].to_string();
+      st.text=s["text"].to_string();
+      auto &u=s["user"];
+      st.user.id=u["id"];
+      st.user.name=u["name"].to_string();
+      st.user.screen_name=u["screen_name"].to_string();
+      st.user.followers_count=u["followers_count"];
+      st.user.verified=u["verified"];
+      st.user.description=u["description"].to_string();
+      for(auto &[key, tags]: s["entities"].get_const_object()){
+        auto &out=st.entities[std::string(key.view())];
+        for(auto &tag: tags.get_const_array()){
+          auto &h=out.emplace_back();
+          h.text=tag["text"].to_string();
+          for(auto &i: tag["indices"].get_const_array()) h.indices.push_back(i);
+        }
+      }
+      if(!s["geo"].is_null()) st.geo=s["geo"].to_string();
+      st.retweet_count=s["retweet_count"];
+      st.favorited=s["favorited"];
+      st.lang=s["lang"].to_string();
+    }
+    return t;
+  }
+
+  // a response of n items built in code, three ways: the values copied into their parents (lvalue inserts),
+  // moved into them (rvalue inserts and emplace), or made in place by a builder
+  std::string item_name(size_t i){
+    return std::format("item number {} of the catalog", i);
+  }
+
+  json build_copy(size_t n){
+    json items=array_t();
+    for(size_t i=0;i<n;++i){
+      json item=object_t(), tags=array_t(), owner=object_t(), name, tag;
+      item.insert("id", json(i));
+      name=item_name(i);
+      item.insert("name", name);
+      item.insert("price", json(i*0.25));
+      for(auto t: {"alpha", "beta"}){
+        tag=t;
+        tags.insert(tag);
+      }
+      item.insert("tags", tags);
+      owner.insert("id", json(i%97));
+      owner.insert("verified", json(true));
+      item.insert("owner", owner);
+      items.insert(item);
+    }
+    json res=object_t();
+    res.insert("status", json(R"("ok")"));
+    res.insert("items", items);
+    return res;
+  }
+
+  json build_move(size_t n){
+    json res=object_t();
+    res.emplace("status", "ok");
+    auto &items=res.emplace("items", array_t());
+    items.get_array().reserve(n);
+    for(size_t i=0;i<n;++i){
+      auto &item=items.emplace_back(object_t());
+      item.get_object().reserve(5);
+      item.emplace("id", i);
+      item.emplace("name", item_name(i));
+      item.emplace("price", i*0.25);
+      auto &tags=item.emplace("tags", array_t());
+      for(auto t: {"alpha", "beta"}) tags.emplace_back(t);
+      item.insert("owner", json{{"id", i%97}, {"verified", json(true)}});
+    }
+    return res;
+  }
+
+  json build_builder(size_t n){
+    builder b;
+    b.begin_object().key("status").value("ok").key("items").begin_array().reserve(n);
+    for(size_t i=0;i<n;++i){
+      b.begin_object().reserve(5).key("id").value(i).key("name").value(item_name(i)).key("price").value(i*0.25);
+      b.key("tags").begin_array().reserve(2).value("alpha").value("beta").end_array();
+      b.key("owner").begin_object().reserve(2).key("id").value(i%97).key("verified").value(true).end_object();
+      b.end_object();
+    }
+    b.end_array().end_object();
+    return std::move(b.result());
+  }
+
+  std::vector<result> run(const corpus &c, const options &opt){
+    std::vector<result> res;
+    auto bench=[&](const std::string &name, size_t bytes, size_t ops, const std::function<void()> &op){
+      if(!opt.filter.empty() && (c.name+"/"+name).find(opt.filter)==std::string::npos) return;
+      double ns=measure(op, ops, opt.min_time);
+      double allocs=count_allocations(op, ops);
+      res.push_back({c.name, name, bytes, ns, allocs, peak_rss_kb()});
+    };
+    std::string_view text=c.text;
+    size_t sink=0;
+
+    bench("parse", text.size(), 1, [&]{
+      json j(text);
+      sink+=j.is_object();
+    });
+    bench("parse_arena", text.size(), 1, [&]{
+      std::pmr::monotonic_buffer_resource arena(text.size()*2);
+      document doc(text, nullptr, &arena);
+      sink+=doc.is_object();
+    });
+    bench("parse_tape", text.size(), 1, [&]{
+      tape t(text);
+      sink+=t.memory();
+    });
+    bench("validate", text.size(), 1, [&]{
+      sink+=bool(validate(text));
+    });
+    bench("parse_strict", text.size(), 1, [&]{
+      auto raw=text;
+      sink+=parser::parse(raw, {.strict=true}).is_object();
+    });
+    parser::stats st;
+    bench("parse_stats", text.size(), 1, [&]{
+      auto raw=text;
+      sink+=parser::parse(raw, {.stats=&st}).is_object()+st.max_depth;
+    });
+
+    // the corpus from a file: mapped against read into a string, for a whole document and up to its first value
+    auto file=(std::filesystem::temp_directory_path()/std::format("xjson_bench_{}.json", c.name)).string();
+    std::ofstream(file, std::ios::binary)<<text;
+    auto read=[&]{
+      std::ifstream in(file, std::ios::binary);
+      return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+    auto first=[&](std::string_view raw){
+      for(auto v: ondemand::document(raw).root()) return size_t(v.type());
+      return size_t(0);
+    };
+    bench("parse_file", text.size(), 1, [&]{
+      sink+=parse_file(file).is_object();
+    });
+    bench("read_parse", text.size(), 1, [&]{
+      sink+=document(read()).is_object();
+    });
+    bench("file_first", 0, 1, [&]{
+      mapped_file mapped(file);
+      sink+=first(mapped.view());
+    });
+    bench("read_first", 0, 1, [&]{
+      sink+=first(read());
+    });
+    std::filesystem::remove(file);
+
+    json root(text);
+    std::string out;
+    bench("serialize", text.size(), 1, [&]{
+      out.clear();
+      writer(out).value(root);
+      sink+=out.size();
+    });
+    bench("roundtrip", text.size(), 1, [&]{
+      sink+=json(text).dump().size();
+    });
+
+    // the elements of a top level array split across threads, against parse of the same array:
+    // the corpus itself when it is an array, the elements of its top level arrays otherwise
+    auto ndjson=lines(root);
+    std::string elements;
+    if(!root.is_array()){
+      elements="["+ndjson+"]";
+      std::replace(elements.begin(), elements.end(), '\n', ',');
+      elements.erase(elements.size()-2, 1);
+      bench("parse_elements", elements.size(), 1, [&]{
+        sink+=json(elements).is_array();
+      });
+    }
+    std::string_view array=root.is_array()? text: std::string_view(elements);
+    for(auto n: sweep(opt.threads)){
+      parallel::pool workers(n);
+      bench(std::format("parse_array_t{}", n), array.size(), 1, [&]{
+        sink+=parallel::parse_array(array, workers).is_array();
+      });
+    }
+
+    // many documents at once: ns/op is per document
+    size_t docs=std::count(ndjson.begin(), ndjson.end(), '\n');
+    for(auto n: sweep(opt.threads)){
+      parallel::pool workers(n);
+      bench(std::format("parse_many_t{}", n), ndjson.size()/docs, docs, [&]{
+        parallel::parse_many(ndjson, workers, [&](json &&j){ sink+=j.is_object(); });
+      });
+    }
+
+    auto picked=sample(root, 1024);
+    if(!picked.empty()){
+      std::vector<path> paths;
+      for(auto &l: picked) paths.emplace_back(l.pointer);
+      bench("lookup_path", 0, paths.size(), [&]{
+        for(auto &p: paths) sink+=p.find(root)!=nullptr;
+      });
+      // the same leaves straight from the input, the subtrees before each step skipped unread
+      ondemand::document lazy(text);
+      bench("lookup_ondemand", 0, picked.size(), [&]{
+        for(auto &l: picked){
+          auto v=lazy.root();
+          for(auto &[key, index]: l.steps) v=key.empty()? v[index]: v[key];
+          sink+=v.is_null();
+        }
+      });
+      bench("lookup_index", 0, picked.size(), [&]{
+        for(auto &l: picked){
+          const json *j=&root;
+          for(auto &[key, index]: l.steps) j=key.empty()? &(*j)[index]: &(*j)[key.c_str()];
+          sink+=j->is_null();
+        }
+      });
+      // the escapes were decoded by the parser, reading a string is a copy
+      std::vector<const json *> strings;
+      for(auto &p: paths)
+        if(auto j=p.find(root);j && j->is_string()) strings.push_back(j);
+      if(!strings.empty())
+        bench("read_strings", 0, strings.size(), [&]{
+          for(auto j: strings) sink+=j->to_string().size();
+        });
+      // one leaf in the middle changed, the rest copied from the input
+      document edited(text, nullptr, parser::options{.retain=true});
+      edited.at(paths[paths.size()/2])=nullptr;
+      bench("serialize_edit", text.size(), 1, [&]{
+        out.clear();
+        writer(out).value(edited);
+        sink+=out.size();
+      });
+      // a shared document: readers on 4 threads each look up every path in their own snapshot,
+      // an update copies the path to one leaf where a mutable json is copied whole
+      shared::publisher pub(shared::document{root});
+      bench("shared_lookup", 0, paths.size(), [&]{
+        auto snap=pub.load();
+        for(auto &p: paths) sink+=snap->find(p)!=nullptr;
+      });
+      bench("shared_read_4t", 0, paths.size()*4, [&]{
+        std::atomic<size_t> found{0};
+        std::vector<std::thread> readers;
+        for(int t=0;t<4;++t)
+          readers.emplace_back([&]{
+            auto snap=pub.load();
+            size_t n=0;
+            for(auto &p: paths) n+=snap->find(p)!=nullptr;
+            found+=n;
+          });
+        for(auto &r: readers) r.join();
+        sink+=found;
+      });
+      size_t next=0;
+      bench("shared_update", 0, 1, [&]{
+        auto &p=paths[next++%paths.size()];
+        pub.publish(pub.load().set(p, json(nullptr)));
+      });
+      bench("deep_copy_update", 0, 1, [&]{
+        json copy=root;
+        copy.at(paths[next++%paths.size()])=nullptr;
+        sink+=copy.is_object();
+      });
+    }
+    if(c.name=="gen_records"){
+      bench("build_copy", 0, 1, [&]{
+        sink+=build_copy(10000).get_const_object().size();
+      });
+      bench("build_move", 0, 1, [&]{
+        sink+=build_move(10000).get_const_object().size();
+      });
+      bench("build_builder", 0, 1, [&]{
+        sink+=build_builder(10000).get_const_object().size();
+      });
+      bench("bind_parse", text.size(), 1, [&]{
+        sink+=bind::parse<timeline>(text).statuses.size();
+      });
+      bench("dom_copy", text.size(), 1, [&]{
+        sink+=copy_timeline(json(text)).statuses.size();
+      });
+      auto typed=bind::parse<timeline>(text);
+      bench("bind_dump", text.size(), 1, [&]{
+        out.clear();
+        writer w(out);
+        bind::write(w, typed);
+        sink+=out.size();
+      });
+    }
+    if(sink==42) std::cerr<<""; // keep the results alive
+    return res;
+  }
+
+  // the ns/op of a previous run, by corpus/case
+  std::map<std::string, double> load_baseline(const std::string &file){
+    std::map<std::string, double> res;
+    std::ifstream in(file, std::ios::binary);
+    if(!in) throw std::runtime_error(std::format("cannot read the baseline {}", file));
+    std::stringstream ss;
+    ss<<in.rdbuf();
+    json j(ss.str());
+    for(auto &r: j["results"].get_const_array())
+      res[r["corpus"].to_string()+"/"+r["case"].to_string()]=double(r["ns_per_op"]);
+    return res;
+  }
+
+  void report(const std::vector<result> &results, const options &opt){
+    auto mbps=[](const result &r){ return r.bytes? r.bytes/r.ns*1e3: 0.0; };
+    if(opt.format=="json"){
+      writer w(std::cout, 2);
+      w.start_object();
+      w.key("label"), w.string(opt.label);
+      w.key("results");
+      w.start_array();
+      for(auto &r: results){
+        w.start_object();
+        w.key("corpus"), w.string(r.corpus);
+        w.key("case"), w.string(r.name);
+        w.key("bytes"), w.number(r.bytes);
+        w.key("ns_per_op"), w.number(r.ns);
+        w.key("mb_per_s"), w.number(mbps(r));
+        w.key("allocs_per_op"), w.number(r.allocs);
+        w.key("peak_rss_kb"), w.number(r.peak_rss_kb);
+        w.end_object();
+      }
+      w.end_array();
+      w.end_object();
+      w.flush();
+      std::cout<<'\n';
+      return;
+    }
+    if(opt.format=="csv"){
+      std::cout<<"label,corpus,case,bytes,ns_per_op,mb_per_s,allocs_per_op,peak_rss_kb\n";
+      for(auto &r: results)
+        std::cout<<std::format("{},{},{},{},{:.1f},{:.2f},{:.2f},{}\n", opt.label, r.corpus, r.name, r.bytes, r.ns, mbps(r), r.allocs, r.peak_rss_kb);
+      return;
+    }
+    std::map<std::string, double> base;
+    if(!opt.baseline.empty()) base=load_baseline(opt.baseline);
+    std::cout<<std::format("{:<24}{:<14}{:>14}{:>10}{:>14}{:>14}", "corpus", "case", "ns/op", "MB/s", "allocs/op", "peak RSS KB");
+    std::cout<<(base.empty()? "\n": "   vs baseline\n");
+    for(auto &r: results){
+      std::cout<<std::format("{:<24}{:<14}{:>14.1f}", r.corpus, r.name, r.ns);
+      std::cout<<(r.bytes? std::format("{:>10.1f}", mbps(r)): std::format("{:>10}", "-"));
+      std::cout<<std::format("{:>14.1f}{:>14}", r.allocs, r.peak_rss_kb);
+      auto it=base.find(r.corpus+"/"+r.name);
+      if(it!=base.end()) std::cout<<std::format("{:>+13.1f}%", (it->second/r.ns-1)*100); // faster is positive
+      std::cout<<'\n';
+    }
+  }
+
+  options parse_options(int argc, char **argv){
+    options opt;
+    for(int i=1;i<argc;++i){
+      std::string arg=argv[i];
+      auto value=[&]()->std::string{
+        if(i+1>=argc) throw std::invalid_argument(std::format("{} needs a value", arg));
+        return argv[++i];
+      };
+      if(arg=="--format") opt.format=value();
+      else if(arg=="--data") opt.data=value();
+      else if(arg=="--filter") opt.filter=value();
+      else if(arg=="--label") opt.label=value();
+      else if(arg=="--baseline") opt.baseline=value();
+      else if(arg=="--min-time") opt.min_time=std::stod(value());
+      else if(arg=="--threads") opt.threads=std::max(1, std::stoi(value()));
+      else throw std::invalid_argument(std::format("unknown option {}", arg));
+    }
+    if(opt.format!="table" && opt.format!="csv" && opt.format!="json")
+      throw std::invalid_argument(std::format("unknown format {}", opt.format));
+    return opt;
+  }
+}
+
+int main(int argc, char **argv)try{
+  auto opt=parse_options(argc, argv);
+  std::vector<result> results;
+  for(auto &c: load(opt)){
+    auto res=run(c, opt);
+    results.insert(results.end(), res.begin(), res.end());
+    if(opt.format=="table") std::cerr<<std::format("{}: {} bytes\n", c.name, c.text.size());
+  }
+  report(results, opt);
+  return 0;
+}catch(const std::exception &e){
+  std::cerr<<"xjson_bench: "<<e.what()<<'\n';
+  return 1;
+}
@@ -3,24 +3,47 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <format>
 #include <forward_list>
 #include <functional>
 #include <initializer_list>
 #include <memory>
+#include <memory_resource>
 #include <optional>
+#include <ostream>
 #include <ranges>
 #include <cctype>
 #include <charconv>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <concepts>
 #include <stdexcept>
+#include <system_error>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <variant>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define XJSON_X86
+#include <immintrin.h>
+#endif
+
+#if __has_include(<unistd.h>)
+#include <cerrno>
+#include <unistd.h>
+#define XJSON_POSIX
+#endif
 
 namespace xihale{
 namespace json{
@@ -61,9 +84,168 @@ namespace json{
   // };
 
   class json;
+  class writer;
+  class path;
+
+  namespace shared{
+    class node;
+    class document;
+  }
+
+  // a key with its hash, computed once: see path
+  struct hashed_key{
+    std::string_view key;
+    size_t hash;
+
+    explicit hashed_key(std::string_view _key): key(_key), hash(std::hash<std::string_view>{}(_key)){}
+    hashed_key(std::string_view _key, size_t _hash): key(_key), hash(_hash){}
+  };
+
+  namespace parser{
+    class reader;
+  }
+
+  // an object key, with its hash: the parser interns them, one copy per distinct key of a document
+  // refcounted on the heap, or immortal in an arena (it goes with the arena, a copy of it goes to the heap)
+  class key{
+  public:
+    key()=default;
+
+    explicit key(std::string_view str, std::pmr::memory_resource *resource=nullptr):
+      key(str, std::hash<std::string_view>{}(str), resource){}
+
+    key(const key &other): r(other.r){
+      if(!r) return;
+      if(r->refs.load(std::memory_order_relaxed)==immortal) r=key(other.view()).release();
+      else r->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    key(key &&other) noexcept: r(other.release()){}
+
+    key &operator=(key other) noexcept {
+      std::swap(r, other.r);
+      return *this;
+    }
+
+    ~key(){
+      if(r && r->refs.load(std::memory_order_relaxed)!=immortal && r->refs.fetch_sub(1, std::memory_order_acq_rel)==1)
+        ::operator delete(r);
+    }
+
+    std::string_view view() const {
+      return r? std::string_view(reinterpret_cast<const char *>(r+1), r->size): std::string_view();
+    }
+
+    operator std::string_view() const {
+      return view();
+    }
+
+    const char *data() const { return view().data(); }
+    size_t size() const { return r? r->size: 0; }
+    size_t hash() const { return r? r->hash: std::hash<std::string_view>{}({}); }
+
+    bool operator==(const key &other) const {
+      return r==other.r || (hash()==other.hash() && view()==other.view());
+    }
+
+    bool operator==(std::string_view other) const {
+      return view()==other;
+    }
+
+  private:
+    friend class parser::reader;
+
+    static constexpr uint32_t immortal=~uint32_t(0);
+
+    struct rep{
+      std::atomic<uint32_t> refs;
+      uint32_t size;
+      size_t hash;
+    }; // followed by the bytes
+
+    rep *r=nullptr;
+
+    rep *release(){
+      return std::exchange(r, nullptr);
+    }
+
+    key(std::string_view str, size_t hash, std::pmr::memory_resource *resource){
+      bool heap=!resource || resource==std::pmr::new_delete_resource();
+      auto bytes=sizeof(rep)+str.size();
+      void *mem=heap? ::operator new(bytes): resource->allocate(bytes, alignof(rep));
+      r=::new (mem) rep{{heap? 1u: immortal}, uint32_t(str.size()), hash};
+      std::memcpy(reinterpret_cast<char *>(r+1), str.data(), str.size());
+    }
+
+    // another reference to the same rep, an immortal one is not copied
+    key share() const {
+      key res;
+      res.r=r;
+      if(r && r->refs.load(std::memory_order_relaxed)!=immortal) r->refs.fetch_add(1, std::memory_order_relaxed);
+      return res;
+    }
+  };
+
+  // an object: the members in insertion order, in one flat array
+  // up to index_min members the keys are searched linearly, from there on a hash index is kept too
+  class object{
+  public:
+    using value_type=std::pair<key, json>;
+    using allocator_type=std::pmr::polymorphic_allocator<value_type>;
+    using iterator=std::pmr::vector<value_type>::iterator;
+    using const_iterator=std::pmr::vector<value_type>::const_iterator;
+
+    static constexpr size_t index_min=16;
+
+    object()=default;
+    explicit object(const allocator_type &alloc): items(alloc){}
+    object(const object &other);
+    object(object &&other) noexcept;
+    object &operator=(const object &other);
+    object &operator=(object &&other);
+    ~object();
+
+    size_t size() const;
+    bool empty() const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    void reserve(size_t n);
+
+    // like a map: nothing is inserted if the key is there already
+    template<typename K, typename ...A>
+    std::pair<iterator, bool> emplace(K &&k, A &&...args);
+
+    iterator find(std::string_view k);
+    const_iterator find(std::string_view k) const;
+    iterator find(const hashed_key &k);
+    const_iterator find(const hashed_key &k) const;
+
+    bool contains(std::string_view k) const;
+
+  private:
+    friend class parser::reader;
+
+    std::pmr::vector<value_type> items{};
+    uint32_t *slots=nullptr; // open addressing: 1 + the position of a member, 0 when empty
+    uint32_t capacity=0;
+
+    std::pmr::memory_resource *resource() const { return items.get_allocator().resource(); }
+
+    size_t locate(std::string_view k) const;
+    size_t locate(std::string_view k, size_t hash) const;
+    std::pair<iterator, bool> insert(key &&k, json &&j);
+    void index(size_t i);
+    void reindex(size_t n=0);
+    void drop_index();
+  };
+
+  // pmr containers: a whole tree can be allocated from one arena, see parser::options::resource
+  typedef object object_t;
+  typedef std::pmr::vector<json> array_t;
 
-  typedef std::unordered_map<std::string, json> object_t;
-  typedef std::vector<json> array_t;
 
   // Concepts
   // template<typename T>
@@ -84,23 +266,77 @@ namespace json{
     concept Array=std::is_same_v<T, array_t>;
 
   namespace parser{
-    static json parse(std::string_view &);
+    // what one parse did, see options::stats
+    struct stats{
+      size_t bytes=0; // of the input read
+      size_t objects=0, arrays=0, strings=0, numbers=0, booleans=0, nulls=0;
+      size_t max_depth=0;
+      size_t allocations=0; // blocks the index and the tree took: containers, copied strings, distinct keys
+      std::chrono::nanoseconds validate{}, index{}, build{}; // time per stage, validate with strict only
+    };
+
+    struct options{
+      bool borrow=false; // keep string values as views into the input instead of copies
+      std::pmr::memory_resource *resource=nullptr; // allocate the whole tree from it, strings become views into it
+      bool retain=false; // remember the input text of every value, see json::source(): the input must outlive the tree
+      bool strict=false; // reject what validate() rejects, instead of reading it the lenient way
+      size_t max_depth=1024; // deeper input is rejected: the tree is freed and written recursively
+                             // with strict, validate() checks it too, allocating only past 4096 levels
+      parser::stats *stats=nullptr; // filled in when set
+    };
+    class reader;
+    inline json parse(std::string_view &, const options & ={});
+    inline std::string unescape(std::string_view);
   };
 
   class json{
   private:
     using ll=long long;
+    using ull=unsigned long long;
     using nullptr_t=std::nullptr_t;
     using string_view=std::string_view;
     using string=std::string;
-    using variant=std::variant<object_t, array_t, string, double, ll, bool, nullptr_t>;
-    variant val;
+    // string_view: a borrowed string, the buffer is kept alive by a document
+    // ull: only the integers above the range of ll
+    using variant=std::variant<object_t, array_t, string, double, ll, bool, nullptr_t, string_view, ull>;
+    // the size of the source goes in the tail padding of the variant where the compiler allows it: 64 bytes in all
+    [[no_unique_address]] variant val;
+    uint32_t src_size=0;
+    const char *src=nullptr; // the input text of this value when parsed with options::retain, null once changed
 
   private:
-    friend json parser::parse(std::string_view &);
+    friend class parser::reader;
+
+    friend class document;
+
+    friend class writer;
+
+    // drop the children without running their destructors
+    // only valid when all of them live in a monotonic arena
+    void abandon(){
+      ::new (static_cast<void *>(&val)) variant(nullptr);
+      changed();
+    }
+
+    // a root is marked until a non const access reaches it, and so until anything in the tree changes:
+    // src_size alone marks it when it has no source, changed() clears both
+    void mark(){
+      if(!src) src_size=1;
+    }
+
+    bool marked() const {
+      return src || src_size;
+    }
+
+    // every non const access goes through here: the value may change, its source no longer matches it
+    // the parents of a value were reached by non const accesses too, so they are marked as well
+    void changed(){
+      src=nullptr, src_size=0;
+    }
 
     std::string_view get_raw() const {
-      return std::get<string>(val).data();
+      if(auto view=std::get_if<string_view>(&val)) return *view;
+      return std::get<string>(val);
     }
 
   public:
@@ -110,12 +346,16 @@ namespace json{
     json &operator=(const json &)=default;
     json &operator=(json &&)=default;
 
-    json(const std::initializer_list<std::pair<std::string_view, json>> &obj){
-      this->val=object_t();
-      auto &val=std::get<object_t>(this->val);
-      for(auto &i:obj)
-        val.insert({string(i.first), std::move(i.second)});
-    }
+    // json{{"id", 1}, {"tags", json(array_t())}}: the values are moved out of the list, not copied
+    struct entry;
+    json(std::initializer_list<entry> obj);
+
+    json(object_t obj): val(std::move(obj)){}
+    json(array_t arr): val(std::move(arr)){}
+    json(nullptr_t): val(nullptr){}
+
+    template<Boolean T>
+    json(const T &b): val(bool(b)){}
 
     // TODO: other initialize_list
 
@@ -126,6 +366,11 @@ namespace json{
 
     template<Integer T>
     json(const T &val){
+      if constexpr(std::is_unsigned_v<T>)
+        if(val>static_cast<ull>(LLONG_MAX)){
+          this->val=static_cast<ull>(val);
+          return;
+        }
       this->val=static_cast<ll>(val);
     }
 
@@ -146,20 +391,26 @@ namespace json{
     }
 
     json& operator[](const char *key){
-      return std::get<object_t>(val).at(key);
+      changed();
+      return const_cast<json &>(std::as_const(*this)[key]);
     }
 
     json& operator[](const size_t &index){ // for arrays
+      changed();
       return std::get<array_t>(val).at(index);
     }
 
     json& operator[](const int &index){
+      changed();
       return std::get<array_t>(val).at(index);
     }
 
     // const operator[]
     const json& operator[](const char *key) const {
-      return std::get<object_t>(val).at(key);
+      auto &obj=std::get<object_t>(val);
+      auto it=obj.find(string_view(key));
+      if(it==obj.end()) throw std::out_of_range(std::format("key not found: {}", key));
+      return it->second;
     }
 
     const json& operator[](const size_t &index) const {
@@ -172,6 +423,7 @@ namespace json{
 
     template<typename T>
     T& get(){
+      changed();
       return std::get<T>(val);
     }
 
@@ -189,6 +441,7 @@ namespace json{
     template <typename T>
     requires std::is_integral_v<T>
     operator T() const {
+      if(auto u=std::get_if<ull>(&val)) return static_cast<T>(*u);
       return static_cast<T>(std::get<ll>(val));
     }
 
@@ -205,75 +458,8 @@ namespace json{
       return get_raw();
     }
 
-    // TODO: try no use rescue
-    operator std::string() const {
-      std::string res;
-      if(std::holds_alternative<object_t>(val)){ // object to string
-        auto &raw=std::get<object_t>(val);
-        res.reserve(raw.size()*10);
-        res.push_back('{');
-        for(auto &i: raw){
-          std::format_to(std::back_inserter(res), "\"{}\":", i.first);
-          if(i.second.is_string())
-            std::format_to(std::back_inserter(res), "\"{}\",", i.second.get_raw());
-          else
-            std::format_to(std::back_inserter(res), "{},", std::string(i.second));
-        }
-        // res.pop_back(); // remove the last ,
-        // res.push_back('}')
-        if(res.back()==',') res.back()='}';
-        else res.push_back('}');
-      }else if(std::holds_alternative<array_t>(val)){ // array to string
-        auto &raw=std::get<array_t>(val);
-        res.reserve(raw.size()*6);
-        res.push_back('[');
-        for(auto &i: raw){
-          if(i.is_string())
-            std::format_to(std::back_inserter(res), "\"{}\",", i.get_raw());
-          else
-            std::format_to(std::back_inserter(res), "{},", std::string(i));
-        }
-        // res.pop_back();
-        // res+="]";
-        if(res.back()==',') res.back()=']';
-        else res.push_back(']');
-      }else if (is_string()){
-        // others to string
-        auto raw=std::string_view(*this);
-        static const std::unordered_map<char, char> trans{
-          {'\\', '\\'},
-          {'"', '"'},
-          {'\'', '\''},
-          {'0', '\0'},
-          {'b', '\b'},
-          {'f', '\f'},
-          {'n', '\n'},
-          {'r', '\r'},
-          {'t', '\t'},
-        };
-        size_t pos=0;
-        res.reserve(raw.length());
-        while(pos<raw.length()){
-          if(raw[pos]=='\\' && pos+1<raw.length()){
-            res+=trans.at(raw[pos+1]);
-            ++pos;
-          }else
-            res+=raw[pos];
-          ++pos;
-        }
-      }
-      else{
-        if(std::holds_alternative<double>(val))
-          res=std::to_string(std::get<double>(val));
-        else if(std::holds_alternative<ll>(val))
-          res=std::to_string(std::get<ll>(val));
-        else if(std::holds_alternative<bool>(val))
-          res=std::get<bool>(val)?"true":"false";
-        else if(std::holds_alternative<nullptr_t>(val))
-          res="null";
-      }
-      return res;
-    }
+    // a string value unescaped, anything else as compact json
+    operator std::string() const;
 
     operator bool() const {
       return std::get<bool>(val);
@@ -292,16 +478,41 @@ namespace json{
     }
 
     bool is_string() const {
-      return std::holds_alternative<std::string>(val);
+      return std::holds_alternative<std::string>(val) || std::holds_alternative<string_view>(val);
+    }
+
+    bool is_number() const {
+      return std::holds_alternative<double>(val) || is_integer();
+    }
+
+    bool is_integer() const {
+      return std::holds_alternative<ll>(val) || std::holds_alternative<ull>(val);
+    }
+
+    // an integer above the range of long long, held as unsigned long long
+    bool is_unsigned() const {
+      return std::holds_alternative<ull>(val);
     }
 
-    bool is_number(){
-      return std::holds_alternative<double>(val) || std::holds_alternative<ll>(val);
+    bool is_double() const {
+      return std::holds_alternative<double>(val);
+    }
+
+    bool is_bool() const {
+      return std::holds_alternative<bool>(val);
     }
 
     template <typename T>
-    json& operator=(T other){
-      val=std::forward<T>(other);
+    requires (!std::is_same_v<std::remove_cvref_t<T>, json>)
+    json& operator=(T &&other){
+      using U=std::remove_cvref_t<T>;
+      if constexpr(Integer<U> && std::is_unsigned_v<U>) val=other>ull(LLONG_MAX)? variant(ull(other)): variant(ll(other)); // ull only when it has to be
+      else if constexpr(Integer<U>) val=ll(other);
+      else if constexpr(std::is_floating_point_v<U>) val=double(other);
+      else if constexpr(std::is_same_v<std::decay_t<T>, const char *> || std::is_same_v<std::decay_t<T>, char *>) val=string(other);
+      else if constexpr(std::is_same_v<U, string_view>) val=string(other); // copied: only the parser borrows
+      else val=std::forward<T>(other);
+      changed();
       return *this;
     }
 
@@ -310,10 +521,17 @@ namespace json{
     //   return std::string(*this)==std::to_string(other);
     // }
 
-    json& insert(const std::string &key, const json &val){
+    json& insert(std::string_view key, const json &val){
       // if(!is_object())
       //   throw exception(not_object, std::string(*this));
-      std::get<object_t>(this->val).insert({key, val});
+      std::get<object_t>(this->val).emplace(key, val);
+      changed();
+      return *this;
+    }
+
+    json& insert(std::string_view key, json &&val){
+      std::get<object_t>(this->val).emplace(key, std::move(val));
+      changed();
       return *this;
     }
 
@@ -321,9 +539,45 @@ namespace json{
       // if(!is_array())
       //   throw exception(not_array, std::string(*this));
       std::get<array_t>(this->val).push_back(val);
+      changed();
+      return *this;
+    }
+
+    json& insert(json &&val){
+      std::get<array_t>(this->val).push_back(std::move(val));
+      changed();
       return *this;
     }
 
+    void push_back(const json &val){
+      insert(val);
+    }
+
+    void push_back(json &&val){
+      insert(std::move(val));
+    }
+
+    // the member `key`, made in place from `val` as operator= would: a string stays a string
+    // like object::emplace, an existing member is returned as it is
+    template<typename ...T>
+    requires (sizeof...(T)<=1)
+    json& emplace(std::string_view key, T &&...val){
+      auto [it, inserted]=std::get<object_t>(this->val).emplace(key);
+      changed();
+      if(inserted) ((it->second=std::forward<T>(val)), ...);
+      return it->second;
+    }
+
+    // a new last element, made in place from `val` as operator= would
+    template<typename ...T>
+    requires (sizeof...(T)<=1)
+    json& emplace_back(T &&...val){
+      auto &res=std::get<array_t>(this->val).emplace_back();
+      changed();
+      ((res=std::forward<T>(val)), ...);
+      return res;
+    }
+
     auto to_string() const {
       return std::string(*this);
     }
@@ -332,10 +586,32 @@ namespace json{
       return std::string_view(*this);
     }
 
+    // the json text, pretty printed with `indent` spaces per level when indent>0
+    std::string dump(size_t indent=0) const;
+
+    // the value at a path, nullptr when there is none: the first one for a path with wildcards or slices
+    json *find(const path &p);
+    const json *find(const path &p) const;
+
+    // the value at a path, or std::out_of_range
+    json &at(const path &p);
+    const json &at(const path &p) const;
+
+    // every value at a path, in one traversal
+    std::vector<const json *> select(const path &p) const;
+
+    // the input text of this value, when it was parsed with parser::options::retain and has not been changed since
+    // (accessed through a non const member): writers copy it as it is instead of writing the value again
+    std::string_view source() const {
+      return std::string_view(src, src? src_size: 0);
+    }
+
     auto &get_object() {
+      changed();
       return std::get<object_t>(val);
     }
     auto &get_array() {
+      changed();
       return std::get<array_t>(val);
     }
 
@@ -347,98 +623,1864 @@ namespace json{
     }
   };
 
+  // mutable: the elements of an initializer_list are const, the values are moved out all the same
+  struct json::entry{
+    std::string_view first;
+    mutable json second;
+  };
+
+  inline json::json(std::initializer_list<entry> obj): val(object_t()){
+    auto &members=std::get<object_t>(val);
+    members.reserve(obj.size());
+    for(auto &i: obj)
+      members.emplace(i.first, std::move(i.second));
+  }
+
+  inline object::object(const object &other): items(other.items){
+    reindex();
+  }
+
+  inline object::object(object &&other) noexcept:
+    items(std::move(other.items)), slots(std::exchange(other.slots, nullptr)), capacity(std::exchange(other.capacity, 0)){}
+
+  inline object &object::operator=(const object &other){
+    if(this!=&other){
+      items=other.items;
+      reindex();
+    }
+    return *this;
+  }
+
+  inline object &object::operator=(object &&other){
+    if(this!=&other){
+      items=std::move(other.items);
+      if(resource()->is_equal(*other.resource())){
+        drop_index();
+        slots=std::exchange(other.slots, nullptr), capacity=std::exchange(other.capacity, 0);
+      }else reindex();
+    }
+    return *this;
+  }
+
+  inline object::~object(){
+    drop_index();
+  }
+
+  inline size_t object::size() const { return items.size(); }
+  inline bool object::empty() const { return items.empty(); }
+  inline object::iterator object::begin() { return items.begin(); }
+  inline object::iterator object::end() { return items.end(); }
+  inline object::const_iterator object::begin() const { return items.begin(); }
+  inline object::const_iterator object::end() const { return items.end(); }
+
+  // the index is sized for n members too, it is not rebuilt while they are inserted
+  inline void object::reserve(size_t n){
+    items.reserve(n);
+    if(n>=index_min && capacity<n*2) reindex(n);
+  }
+
+  inline object::iterator object::find(std::string_view k){
+    return begin()+locate(k);
+  }
+
+  inline object::const_iterator object::find(std::string_view k) const {
+    return begin()+locate(k);
+  }
+
+  inline object::iterator object::find(const hashed_key &k){
+    return begin()+locate(k.key, k.hash);
+  }
+
+  inline object::const_iterator object::find(const hashed_key &k) const {
+    return begin()+locate(k.key, k.hash);
+  }
+
+  inline bool object::contains(std::string_view k) const {
+    return find(k)!=end();
+  }
+
+  template<typename K, typename ...A>
+  std::pair<object::iterator, bool> object::emplace(K &&k, A &&...args){
+    if constexpr(std::is_same_v<std::remove_cvref_t<K>, key>) return insert(key(std::forward<K>(k)), json(std::forward<A>(args)...));
+    else return insert(key(std::string_view(k), resource()), json(std::forward<A>(args)...));
+  }
+
+  // the position of the member `k`, or size(): small objects are scanned without hashing `k`
+  inline size_t object::locate(std::string_view k) const {
+    return locate(k, slots? std::hash<std::string_view>{}(k): 0);
+  }
+
+  inline size_t object::locate(std::string_view k, size_t hash) const {
+    if(!slots){
+      for(size_t i=0;i<items.size();++i)
+        if(items[i].first.view()==k) return i;
+      return items.size();
+    }
+    for(auto s=hash & (capacity-1);slots[s];s=(s+1) & (capacity-1)){
+      auto &member=items[slots[s]-1].first;
+      if(member.hash()==hash && member.view()==k) return slots[s]-1;
+    }
+    return items.size();
+  }
+
+  // the keys interned by the parser compare by address first
+  inline std::pair<object::iterator, bool> object::insert(key &&k, json &&j){
+    if(!slots){
+      for(auto it=items.begin();it!=items.end();++it)
+        if(it->first==k) return {it, false};
+    }else if(auto i=locate(k.view(), k.hash());i<items.size()) return {items.begin()+i, false};
+    items.emplace_back(std::move(k), std::move(j));
+    if(slots && items.size()*2<=capacity) index(items.size()-1);
+    else if(items.size()>=index_min) reindex();
+    return {items.end()-1, true};
+  }
+
+  inline void object::index(size_t i){
+    auto s=items[i].first.hash() & (capacity-1);
+    while(slots[s]) s=(s+1) & (capacity-1);
+    slots[s]=i+1;
+  }
+
+  // an index for at least n members
+  inline void object::reindex(size_t n){
+    drop_index();
+    n=std::max(n, items.size());
+    if(n<index_min) return;
+    capacity=std::bit_ceil(n*4);
+    slots=static_cast<uint32_t *>(resource()->allocate(capacity*sizeof(uint32_t), alignof(uint32_t)));
+    std::fill(slots, slots+capacity, 0);
+    for(size_t i=0;i<items.size();++i) index(i);
+  }
+
+  inline void object::drop_index(){
+    if(slots) resource()->deallocate(slots, capacity*sizeof(uint32_t), alignof(uint32_t));
+    slots=nullptr, capacity=0;
+  }
+
   namespace parser{
 
     using std::string_view;
     using string=std::string;
     using ll=long long;
     static auto &npos=string_view::npos;
-    // static void trim_left(string_view &raw){
-    //   auto bpos=raw.find_first_not_of(' ');
-    //   if(bpos!=npos) raw.remove_prefix(bpos);
-    // }
 
-    static bool is_blank(const char &ch){
+    inline bool is_blank(const char &ch){
       return ch==' ' || ch=='\t' || ch=='\n' || ch=='\r';
     }
-    static char next(string_view &raw){
-      while(is_blank(static_cast<uint8_t>(raw.front()))) raw.remove_prefix(1);
-      raw.remove_prefix(1);
-      return *(raw.data()-1);
+
+    // copies raw[i..] to out up to the next backslash or the end, 16 bytes at a time: the bytes copied
+    // out must have room for 16 bytes past them
+    inline size_t copy_plain(string_view raw, size_t i, char *out){
+      size_t n=0;
+#ifdef XJSON_X86
+      for(;i+n+16<=raw.size();n+=16){
+        auto in=_mm_loadu_si128(reinterpret_cast<const __m128i *>(raw.data()+i+n));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out+n), in);
+        if(auto bits=unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8('\\'))))) return n+std::countr_zero(bits);
+      }
+#endif
+      for(;i+n<raw.size() && raw[i+n]!='\\';++n) out[n]=raw[i+n];
+      return n;
+    }
+
+    inline bool hex4(string_view raw, size_t i, uint32_t &cp){
+      if(i>raw.size() || raw.size()-i<4) return false;
+      cp=0;
+      for(size_t k=i;k<i+4;++k){
+        auto c=raw[k];
+        if(c>='0' && c<='9') cp=cp<<4 | (c-'0');
+        else if((c|0x20)>='a' && (c|0x20)<='f') cp=cp<<4 | ((c|0x20)-'a'+10);
+        else return false;
+      }
+      return true;
     }
 
-    static char forward(string_view &raw){
-      bool vis=is_blank(static_cast<uint8_t>(raw.front()));
-      while(is_blank(static_cast<uint8_t>(raw.front()))) raw.remove_prefix(1);
-      return *(raw.data()-vis);
+    inline size_t utf8(uint32_t cp, char *out){
+      if(cp<0x80) return out[0]=char(cp), 1;
+      if(cp<0x800) return out[0]=char(0xc0 | cp>>6), out[1]=char(0x80 | (cp & 0x3f)), 2;
+      if(cp<0x10000) return out[0]=char(0xe0 | cp>>12), out[1]=char(0x80 | (cp>>6 & 0x3f)), out[2]=char(0x80 | (cp & 0x3f)), 3;
+      out[0]=char(0xf0 | cp>>18), out[1]=char(0x80 | (cp>>12 & 0x3f)), out[2]=char(0x80 | (cp>>6 & 0x3f)), out[3]=char(0x80 | (cp & 0x3f));
+      return 4;
     }
 
+    // decodes the escapes of raw into out, which has room for raw.size()+16 bytes: the bytes written, never more than raw.size()
+    // \uXXXX becomes utf-8, a surrogate pair one code point, a lone surrogate U+FFFD
+    // leniently, an unknown escape (or a \u without 4 hex digits) stands for the character after the backslash
+    inline size_t unescape(string_view raw, char *out){
+      size_t i=0, o=0;
+      for(;;){
+        auto n=copy_plain(raw, i, out+o);
+        i+=n, o+=n;
+        if(i+1>=raw.size()) return i<raw.size()? (out[o]='\\', o+1): o;
+        char c=raw[i+1];
+        i+=2;
+        uint32_t cp, low;
+        switch(c){
+          case 'b': out[o++]='\b'; break;
+          case 'f': out[o++]='\f'; break;
+          case 'n': out[o++]='\n'; break;
+          case 'r': out[o++]='\r'; break;
+          case 't': out[o++]='\t'; break;
+          case 'u':
+            if(!hex4(raw, i, cp)){
+              out[o++]=c;
+              break;
+            }
+            i+=4;
+            if(cp>=0xd800 && cp<0xdc00 && raw.substr(i, 2)=="\\u" && hex4(raw, i+2, low) && low>=0xdc00 && low<0xe000){
+              cp=0x10000+((cp-0xd800)<<10)+(low-0xdc00);
+              i+=6;
+            }else if(cp>=0xd800 && cp<0xe000) cp=0xfffd;
+            o+=utf8(cp, out+o);
+            break;
+          default: out[o++]=c; // " \ /
+        }
+      }
+    }
 
-    // static bool forward(string_view &raw, const string_view &judge){
-    //   return raw.starts_with(judge.substr(1));
-    // }
+    inline std::string unescape(string_view raw){
+      if(!std::memchr(raw.data(), '\\', raw.size())) return string(raw);
+      string res(raw.size()+16, '\0');
+      res.resize(unescape(raw, res.data()));
+      return res;
+    }
 
-    static void skip_until(string_view &raw, const char &judge){
-      while(next(raw)!=judge);
-    }
-
-    static void skip(string_view &raw){
-      char ch;
-      while(!raw.empty() && (ch=raw[0])!=',' && ch!='}' && ch!=']') raw.remove_prefix(1);
-    }
-
-    static json parse(string_view &raw){
-      json j;
-      auto &v=j.val;
-      auto begin=next(raw);
-      if(begin=='{'){
-        char ch;
-        v=object_t{};
-        auto &o=std::get<object_t>(v);
-        while((ch=next(raw))=='"'){
-          auto bpos=raw.begin();
-          skip_until(raw, '"');
-          auto key=string(bpos, raw.begin()-1);
-          next(raw); // :
-          o.insert({key, parse(raw)});
-          if(forward(raw)==',') next(raw);
+    // whether the text of a string is json as it is: no control character, only the known escapes
+    inline bool exact_string(string_view raw){
+      uint32_t cp;
+      for(size_t i=0;i<raw.size();++i){
+        if(uint8_t(raw[i])<0x20) return false;
+        if(raw[i]!='\\') continue;
+        if(++i==raw.size()) return false;
+        switch(raw[i]){
+          case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': break;
+          case 'u':
+            if(!hex4(raw, i+1, cp)) return false;
+            i+=4;
+            break;
+          default: return false;
         }
-      }else if(begin=='['){
-        // char ch;
-        v=array_t{};
-        auto &a=std::get<array_t>(v);
-        a.reserve(4);
-        // if(forward(raw)==']'){ next(raw); return j; }
-        // raw=string_view(raw.begin()-1, raw.end());
-        while(forward(raw)!=']'){
-          a.push_back(parse(raw));
-          if(forward(raw)==',') next(raw);
+      }
+      return true;
+    }
+
+    // the first byte of a token that breaks the grammar of a literal or of -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?,
+    // and why, npos when it is valid
+    inline size_t check_token(string_view token, const char *&why){
+      auto p=token.data(), stop=p+token.size();
+      auto bad=[&](const char *what){
+        why=what;
+        return size_t(p-token.data());
+      };
+      auto literal=[&](string_view word){ return token==word? string_view::npos: bad("invalid literal"); };
+      if(p==stop) return bad("invalid literal");
+      switch(*p){
+        case 't': return literal("true");
+        case 'f': return literal("false");
+        case 'n': return literal("null");
+        case '-': ++p; break;
+        default:
+          if(*p<'0' || *p>'9') return bad("invalid literal");
+      }
+      auto digits=[&]{
+        auto from=p;
+        while(p<stop && uint8_t(*p-'0')<10) ++p;
+        return p>from;
+      };
+      if(p<stop && *p=='0') ++p;
+      else if(!digits()) return bad("invalid number");
+      if(p==stop) return string_view::npos;
+      if(*p=='.' && (++p, !digits())) return bad("invalid number");
+      if(p<stop && (*p=='e' || *p=='E')){
+        ++p;
+        if(p<stop && (*p=='+' || *p=='-')) ++p;
+        if(!digits()) return bad("invalid number");
+      }
+      return p==stop? string_view::npos: bad("invalid number");
+    }
+
+    // a number token, kept as an integer when it has no fraction
+    struct number{
+      enum kind{ invalid, integer, unsigned_integer, real } type;
+      ll i;
+      unsigned long long u; // unsigned_integer: above the range of ll
+      double d;
+    };
+
+    // 8 ascii digits, read as one little endian word
+    inline bool eight_digits(uint64_t v){
+      return ((v & 0xf0f0f0f0f0f0f0f0) | (((v+0x0606060606060606) & 0xf0f0f0f0f0f0f0f0)>>4))==0x3333333333333333;
+    }
+
+    inline uint64_t eight_digits_value(uint64_t v){
+      v-=0x3030303030303030;
+      v=v*10+(v>>8); // pairs
+      return (((v & 0x000000ff000000ff)*(100+(1000000ull<<32)))+(((v>>16) & 0x000000ff000000ff)*(1+(10000ull<<32))))>>32;
+    }
+
+    // integers are exact: ll, or unsigned long long above its range, read 8 digits at a time
+    // a fraction, an exponent, or more than 64 bits make a correctly rounded double
+    inline number parse_number(string_view token){
+      number n{number::invalid, 0, 0, 0};
+      auto p=token.data(), end=p+token.size();
+      bool negative=p<end && *p=='-';
+      auto digits=p+negative, q=digits;
+      uint64_t v=0;
+      if constexpr(std::endian::native==std::endian::little){
+        uint64_t word;
+        // at most 16 digits this way, no overflow
+        while(q-digits<=8 && end-q>=8 && (std::memcpy(&word, q, 8), eight_digits(word)))
+          v=v*100000000+eight_digits_value(word), q+=8;
+      }
+      bool overflow=false;
+      for(;q<end && *q>='0' && *q<='9';++q){
+        unsigned d=*q-'0';
+        if(v>(UINT64_MAX-d)/10) overflow=true;
+        else v=v*10+d;
+      }
+      if(q==end && q>digits && !overflow){
+        if(!negative && v>uint64_t(LLONG_MAX)) n.type=number::unsigned_integer, n.u=v;
+        else if(!negative) n.type=number::integer, n.i=v;
+        else if(v<=uint64_t(LLONG_MAX)+1) n.type=number::integer, n.i=ll(0-v);
+        if(n.type!=number::invalid) return n;
+      }
+      auto res=std::from_chars(p, end, n.d);
+      if(res.ec==std::errc() && res.ptr==end) n.type=number::real;
+      else if(res.ec==std::errc::result_out_of_range && res.ptr==end){
+        // past the range of a double: at least 1 overflows to infinity, below it underflows to 0
+        // the decimal exponent of the first significant digit tells which
+        ll lead=0, exp=0;
+        bool point=false, seen=false;
+        auto r=digits;
+        for(;r<end && *r!='e' && *r!='E';++r){
+          if(*r=='.') point=true;
+          else if(seen || *r!='0') seen=true, lead+=!point;
+          else lead-=point;
         }
-        next(raw); // ]
-      }else if(begin=='"'){
-        auto bpos=raw.begin();
-        skip_until(raw, '"');
-        v=string(bpos, raw.begin()-1);
-      }else if(begin=='t'){ // true
-        v=true, skip(raw);
-      }else if(begin=='f'){ // false
-        v=false, skip(raw);
-      }else if(begin=='n'){ // null
-        v=nullptr, skip(raw);
-      }else{ // number or string
-        std::from_chars_result res;
-        auto bpos=raw.begin()-1;
-        skip(raw);
-        v=(double)0;
-        res=std::from_chars(bpos, raw.begin(), (double&)v);
-        ll i=std::get<double>(v);
-        if(std::get<double>(v)-i<1e-6) v=i;
-        if(res.ec!=std::errc() || res.ptr!=raw.begin()){
-          v=string(bpos, raw.begin()); // regarded as String
+        if(r<end){
+          bool below=*++r=='-';
+          r+=*r=='-' || *r=='+';
+          for(;r<end;++r) exp=std::min<ll>(exp*10+(*r-'0'), LLONG_MAX/16);
+          if(below) exp=-exp;
         }
+        n.type=number::real;
+        n.d=lead+exp>0? HUGE_VAL: 0.0;
+        if(negative) n.d=-n.d;
       }
-      return j;
+      return n;
     }
-  }
+
+    // stage 1: find every structural position of the input, 64 bytes at a time
+    // structural: {}[]:, outside strings, both quotes of a string and the first byte of a scalar
+
+    enum class kernel{ automatic, scalar, sse2, avx2 };
+
+    inline bool supported(kernel k){
+      switch(k){
+#ifdef XJSON_X86
+        case kernel::sse2: return true;
+        case kernel::avx2: return __builtin_cpu_supports("avx2");
+#endif
+        case kernel::automatic:
+        case kernel::scalar: return true;
+        default: return false;
+      }
+    }
+
+    struct index{
+      std::unique_ptr<uint32_t[]> pos{}; // offsets into the input, in order
+      size_t size=0;
+      size_t bytes=0; // of the input indexed: all of it, unless only its first value was asked for
+    };
+
+    // one bit per byte of a 64 bytes block
+    // op: {}[]:, and among them open: {[, close: }] and colon; digit: 0-9
+    struct block{
+      uint64_t quote, backslash, op, blank, control, open, close, colon, digit;
+    };
+
+    inline block classify_scalar(const char *p){
+      block b{0, 0, 0, 0, 0, 0, 0, 0, 0};
+      for(size_t i=0;i<64;++i){
+        uint64_t bit=uint64_t(1)<<i;
+        switch(p[i]){
+          case '"': b.quote|=bit; break;
+          case '\\': b.backslash|=bit; break;
+          case '{': case '[': b.op|=bit, b.open|=bit; break;
+          case '}': case ']': b.op|=bit, b.close|=bit; break;
+          case ':': b.op|=bit, b.colon|=bit; break;
+          case ',': b.op|=bit; break;
+          case ' ': case '\t': case '\n': case '\r': b.blank|=bit; break;
+        }
+        if(uint8_t(p[i])<0x20) b.control|=bit;
+        if(uint8_t(p[i]-'0')<10) b.digit|=bit;
+      }
+      return b;
+    }
+
+#ifdef XJSON_X86
+    [[gnu::always_inline]] inline block classify_sse2(const char *p){
+      block b{0, 0, 0, 0, 0, 0, 0, 0, 0};
+      for(size_t i=0;i<64;i+=16){
+        auto in=_mm_loadu_si128(reinterpret_cast<const __m128i *>(p+i));
+        auto eq=[&](char ch){ return _mm_cmpeq_epi8(in, _mm_set1_epi8(ch)); };
+        auto bits=[&](__m128i m){ return uint64_t(uint16_t(_mm_movemask_epi8(m)))<<i; };
+        // {} and [] only differ by 0x20
+        auto lower=_mm_or_si128(in, _mm_set1_epi8(0x20));
+        auto open=_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), close=_mm_cmpeq_epi8(lower, _mm_set1_epi8('}'));
+        auto bracket=_mm_or_si128(open, close);
+        b.open|=bits(open);
+        b.close|=bits(close);
+        b.quote|=bits(eq('"'));
+        b.backslash|=bits(eq('\\'));
+        auto colon=eq(':');
+        b.colon|=bits(colon);
+        b.op|=bits(_mm_or_si128(bracket, _mm_or_si128(colon, eq(','))));
+        b.blank|=bits(_mm_or_si128(_mm_or_si128(eq(' '), eq('\t')), _mm_or_si128(eq('\n'), eq('\r'))));
+        b.control|=bits(_mm_cmpeq_epi8(_mm_max_epu8(in, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f)));
+        b.digit|=bits(_mm_cmpeq_epi8(_mm_max_epu8(_mm_sub_epi8(in, _mm_set1_epi8('0')), _mm_set1_epi8(9)), _mm_set1_epi8(9)));
+      }
+      return b;
+    }
+
+    __attribute__((target("avx2")))
+    [[gnu::always_inline]] inline block classify_avx2(const char *p){
+      block b{0, 0, 0, 0, 0, 0, 0, 0, 0};
+      for(size_t i=0;i<64;i+=32){
+        auto in=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p+i));
+        auto eq=[&](char ch) __attribute__((target("avx2"))) { return _mm256_cmpeq_epi8(in, _mm256_set1_epi8(ch)); };
+        auto bits=[&](__m256i m) __attribute__((target("avx2"))) { return uint64_t(uint32_t(_mm256_movemask_epi8(m)))<<i; };
+        auto lower=_mm256_or_si256(in, _mm256_set1_epi8(0x20));
+        auto open=_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), close=_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'));
+        auto bracket=_mm256_or_si256(open, close);
+        b.open|=bits(open);
+        b.close|=bits(close);
+        b.quote|=bits(eq('"'));
+        b.backslash|=bits(eq('\\'));
+        auto colon=eq(':');
+        b.colon|=bits(colon);
+        b.op|=bits(_mm256_or_si256(bracket, _mm256_or_si256(colon, eq(','))));
+        b.blank|=bits(_mm256_or_si256(_mm256_or_si256(eq(' '), eq('\t')), _mm256_or_si256(eq('\n'), eq('\r'))));
+        b.control|=bits(_mm256_cmpeq_epi8(_mm256_max_epu8(in, _mm256_set1_epi8(0x1f)), _mm256_set1_epi8(0x1f)));
+        b.digit|=bits(_mm256_cmpeq_epi8(_mm256_max_epu8(_mm256_sub_epi8(in, _mm256_set1_epi8('0')), _mm256_set1_epi8(9)), _mm256_set1_epi8(9)));
+      }
+      return b;
+    }
+#endif
+
+    // bits of the characters escaped by an odd run of backslashes
+    // `carry` tells whether the first byte of the next block is escaped
+    inline uint64_t find_escaped(uint64_t backslash, uint64_t &carry){
+      constexpr uint64_t even=0x5555555555555555ULL;
+      backslash&=~carry;
+      uint64_t follows=(backslash<<1) | carry;
+      uint64_t odd_starts=backslash & ~even & ~follows;
+      uint64_t even_runs=odd_starts+backslash;
+      carry=even_runs<odd_starts;
+      return (even ^ (even_runs<<1)) & follows;
+    }
+
+    // bit i = xor of bits 0..i
+    inline uint64_t prefix_xor(uint64_t bits){
+      bits^=bits<<1;
+      bits^=bits<<2;
+      bits^=bits<<4;
+      bits^=bits<<8;
+      bits^=bits<<16;
+      bits^=bits<<32;
+      return bits;
+    }
+
+    // carries the string/escape/scalar state from one block to the next
+    struct indexer{
+      uint32_t *out;
+      uint64_t escaped_carry=0, in_string_carry=0, scalar_carry=0;
+      uint64_t open=0, close=0; // the brackets of the last block, outside strings
+
+      [[gnu::always_inline]] inline void step(const block &b, uint32_t base){
+        uint64_t quote=b.quote & ~find_escaped(b.backslash, escaped_carry);
+        uint64_t in_string=prefix_xor(quote) ^ in_string_carry; // opening quote included, closing one excluded
+        in_string_carry=uint64_t(int64_t(in_string)>>63);
+        open=b.open & ~in_string, close=b.close & ~in_string;
+        uint64_t scalar=~(b.op | b.blank | quote | in_string);
+        uint64_t bits=(b.op & ~in_string) | quote | (scalar & ~((scalar<<1) | scalar_carry));
+        scalar_carry=scalar>>63;
+        // unconditional writes for the common counts, the buffer has room for the extra ones
+        auto cnt=std::popcount(bits);
+        auto emit=[&](uint32_t *p){
+          *p=base+std::countr_zero(bits | (uint64_t(1)<<63));
+          bits&=bits-1;
+        };
+        for(int k=0;k<8;++k) emit(out+k);
+        if(cnt>8){
+          for(int k=8;k<16;++k) emit(out+k);
+          for(int k=16;bits;++k) emit(out+k);
+        }
+        out+=cnt;
+      }
+
+      // the last partial block is padded with blanks, never read past the input
+      void tail(string_view raw, size_t i, block (*classify)(const char *)){
+        if(i>=raw.size()) return;
+        char buf[64];
+        std::fill(std::begin(buf), std::end(buf), ' ');
+        std::copy(raw.begin()+i, raw.end(), buf);
+        step(classify(buf), i);
+      }
+    };
+
+    // after(i): called after each whole block, the one at i, true to stop there
+    // returns the bytes indexed
+    template<block (*classify)(const char *), typename F>
+    inline size_t index_blocks(string_view raw, indexer &ix, F &after){
+      size_t i=0;
+      for(;i+64<=raw.size();i+=64){
+        ix.step(classify(raw.data()+i), i);
+        if(after(i)) return i+64;
+      }
+      ix.tail(raw, i, classify);
+      return raw.size();
+    }
+
+#ifdef XJSON_X86
+    template<typename F>
+    __attribute__((target("avx2")))
+    inline size_t index_blocks_avx2(string_view raw, indexer &ix, F &after){
+      size_t i=0;
+      for(;i+64<=raw.size();i+=64){
+        ix.step(classify_avx2(raw.data()+i), i);
+        if(after(i)) return i+64;
+      }
+      ix.tail(raw, i, classify_avx2);
+      return raw.size();
+    }
+#endif
+
+    // follows the first value of the input as its blocks are indexed: done once the position after its end
+    // is there too, the reader needs it to end a scalar and to stop
+    // a container ends where the depth of its brackets, counted from the masks of the blocks, is 0 again
+    struct first_value{
+      enum{ start, container, string, ended } state=start;
+      int64_t depth=0;
+      size_t end=0; // the last byte of the value, once ended
+
+      bool operator()(string_view raw, const indexer &ix, const uint32_t *pos, size_t size, size_t base){
+        if(!size) return false;
+        if(state==start){
+          auto c=raw[pos[0]];
+          state=c=='{' || c=='['? container: c=='"'? string: ended;
+          end=pos[0];
+        }
+        if(state==string && size>1) state=ended, end=pos[1]; // the closing quote
+        if(state==container){
+          if(depth>std::popcount(ix.close)){ // cannot end in this block
+            depth+=std::popcount(ix.open)-std::popcount(ix.close);
+            return false;
+          }
+          for(auto all=ix.open | ix.close;all;all&=all-1){
+            auto k=std::countr_zero(all);
+            depth+=(ix.open>>k & 1)? 1: -1;
+            if(depth==0){
+              state=ended, end=base+k;
+              break;
+            }
+          }
+        }
+        return state==ended && pos[size-1]>end;
+      }
+    };
+
+    // the offsets are 32 bits: a bigger input is rejected rather than read wrong
+    // first: index only as far as the first value of the input, see first_value
+    inline index build_index(string_view raw, kernel k=kernel::automatic, bool first=false){
+      if(raw.size()>UINT32_MAX)
+        throw std::length_error(std::format("json input of {} bytes: at most 4 GiB can be indexed", raw.size()));
+      index idx;
+      idx.pos.reset(new uint32_t[raw.size()+64]);
+      indexer ix{idx.pos.get()};
+      first_value value;
+      auto after=[&](size_t i){
+        return first && value(raw, ix, idx.pos.get(), ix.out-idx.pos.get(), i);
+      };
+#ifdef XJSON_X86
+      static const bool avx2=supported(kernel::avx2);
+      if(k==kernel::automatic) k=avx2? kernel::avx2: kernel::sse2;
+      if(k==kernel::avx2) idx.bytes=index_blocks_avx2(raw, ix, after);
+      else if(k==kernel::sse2) idx.bytes=index_blocks<classify_sse2>(raw, ix, after);
+      else
+#endif
+      idx.bytes=index_blocks<classify_scalar>(raw, ix, after);
+      idx.size=ix.out-idx.pos.get();
+      return idx;
+    }
+
+    // validation: the whole grammar of RFC 8259 and utf-8, nothing is built nor allocated
+
+    struct validation{
+      const char *error=nullptr; // what is wrong, null when the input is valid
+      size_t offset=0; // the byte where it goes wrong
+
+      explicit operator bool() const {
+        return !error;
+      }
+    };
+
+    // the offset of the first sequence that is not utf-8 from i on, npos when there is none
+    // overlong forms, surrogates and code points above 10FFFF are rejected
+    inline size_t utf8_error_scalar(string_view raw, size_t i=0){
+      auto s=reinterpret_cast<const unsigned char *>(raw.data());
+      while(i<raw.size()){
+        if(s[i]<0x80){
+          ++i;
+          continue;
+        }
+        size_t len;
+        uint32_t cp, min;
+        if((s[i] & 0xe0)==0xc0) len=2, cp=s[i] & 0x1f, min=0x80;
+        else if((s[i] & 0xf0)==0xe0) len=3, cp=s[i] & 0x0f, min=0x800;
+        else if((s[i] & 0xf8)==0xf0) len=4, cp=s[i] & 0x07, min=0x10000;
+        else return i;
+        if(raw.size()-i<len) return i;
+        for(size_t k=1;k<len;++k){
+          if((s[i+k] & 0xc0)!=0x80) return i;
+          cp=cp<<6 | (s[i+k] & 0x3f);
+        }
+        if(cp<min || cp>0x10ffff || (cp>=0xd800 && cp<=0xdfff)) return i;
+        i+=len;
+      }
+      return string_view::npos;
+    }
+
+    // back from i to the start of the sequence going over it, so the scalar check can resume there
+    inline size_t utf8_resume(string_view raw, size_t i){
+      for(size_t j=i;j>0 && i-j<3;--j){
+        auto ch=uint8_t(raw[j-1]);
+        if(ch<0x80) return j;
+        if(ch>=0xc0) return j-1;
+      }
+      return i;
+    }
+
+#ifdef XJSON_X86
+    // ascii is skipped 16 bytes at a time
+    inline size_t utf8_error_sse2(string_view raw){
+      size_t i=0;
+      for(;i+16<=raw.size();i+=16){
+        auto in=_mm_loadu_si128(reinterpret_cast<const __m128i *>(raw.data()+i));
+        if(_mm_movemask_epi8(in)) break;
+      }
+      return utf8_error_scalar(raw, i);
+    }
+
+    // 32 bytes at a time with three table lookups, Keiser and Lemire, "Validating UTF-8 in less than one instruction per byte"
+    // each lookup gives the errors a pair of bytes may be part of: they are only errors when all three agree
+    __attribute__((target("avx2")))
+    inline size_t utf8_error_avx2(string_view raw){
+      constexpr uint8_t too_short=1<<0, too_long=1<<1, overlong_3=1<<2, too_large=1<<3, surrogate=1<<4,
+        overlong_2=1<<5, too_large_1000=1<<6, overlong_4=1<<6, two_conts=1<<7, carry=too_short | too_long | two_conts;
+      // by the high nibble of the previous byte, by its low nibble and by the high nibble of the byte
+      alignas(16) static constexpr uint8_t prev_high[16]={
+        too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+        two_conts, two_conts, two_conts, two_conts,
+        too_short | overlong_2, too_short, too_short | overlong_3 | surrogate, too_short | too_large | too_large_1000 | overlong_4
+      };
+      alignas(16) static constexpr uint8_t prev_low[16]={
+        carry | overlong_3 | overlong_2 | overlong_4, carry | overlong_2, carry, carry,
+        carry | too_large, carry | too_large | too_large_1000, carry | too_large | too_large_1000, carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000, carry | too_large | too_large_1000, carry | too_large | too_large_1000, carry | too_large | too_large_1000,
+        carry | too_large | too_large_1000, carry | too_large | too_large_1000 | surrogate, carry | too_large | too_large_1000, carry | too_large | too_large_1000
+      };
+      alignas(16) static constexpr uint8_t cur_high[16]={
+        too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+        too_long | overlong_2 | two_conts | overlong_3 | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_long | overlong_2 | two_conts | surrogate | too_large,
+        too_short, too_short, too_short, too_short
+      };
+      // above these, the last three bytes start a sequence that does not end in the chunk
+      alignas(32) static constexpr uint8_t last[32]={
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xf0-1, 0xe0-1, 0xc0-1
+      };
+      auto t_prev_high=_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(prev_high)));
+      auto t_prev_low=_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(prev_low)));
+      auto t_cur_high=_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(cur_high)));
+      auto nibble=_mm256_set1_epi8(0x0f), max=_mm256_load_si256(reinterpret_cast<const __m256i *>(last));
+      auto prev=_mm256_setzero_si256(), incomplete=_mm256_setzero_si256();
+      size_t i=0;
+      for(;i+32<=raw.size();i+=32){
+        auto in=_mm256_loadu_si256(reinterpret_cast<const __m256i *>(raw.data()+i));
+        auto error=incomplete;
+        if(_mm256_movemask_epi8(in)){
+          // the input shifted by 1, 2 and 3 bytes, the last bytes of the previous chunk coming in
+          auto joined=_mm256_permute2x128_si256(prev, in, 0x21);
+          auto prev1=_mm256_alignr_epi8(in, joined, 15), prev2=_mm256_alignr_epi8(in, joined, 14), prev3=_mm256_alignr_epi8(in, joined, 13);
+          auto special=_mm256_and_si256(
+            _mm256_and_si256(
+              _mm256_shuffle_epi8(t_prev_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+              _mm256_shuffle_epi8(t_prev_low, _mm256_and_si256(prev1, nibble))),
+            _mm256_shuffle_epi8(t_cur_high, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+          // the third and fourth bytes of a sequence must be continuations, and nothing else may be one
+          auto third=_mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xe0-0x80)));
+          auto fourth=_mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xf0-0x80)));
+          auto must_continue=_mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+          error=_mm256_xor_si256(must_continue, special);
+          incomplete=_mm256_subs_epu8(in, max);
+        }else incomplete=_mm256_setzero_si256();
+        if(!_mm256_testz_si256(error, error)) return utf8_error_scalar(raw, utf8_resume(raw, i));
+        prev=in;
+      }
+      return utf8_error_scalar(raw, utf8_resume(raw, i));
+    }
+#endif
+
+    inline size_t utf8_error(string_view raw, kernel k=kernel::automatic){
+#ifdef XJSON_X86
+      static const bool avx2=supported(kernel::avx2);
+      if(k==kernel::automatic) k=avx2? kernel::avx2: kernel::sse2;
+      if(k==kernel::avx2) return utf8_error_avx2(raw);
+      if(k==kernel::sse2) return utf8_error_sse2(raw);
+#endif
+      return utf8_error_scalar(raw);
+    }
+
+    // the grammar, from the same block masks as the parser: every kind of token is carried over the blanks
+    // to the token after it, so what may follow what is checked for a whole block at once;
+    // only the brackets (depth, matching, object or array around the commas) and the scalars go one by one
+    class validator{
+    public:
+      static constexpr size_t depth_limit=4096; // levels kept without allocating
+
+      validator(string_view _raw, size_t _max_depth): raw(_raw), max_depth(_max_depth){}
+
+      [[gnu::always_inline]] inline bool step(const block &b, size_t base){
+        uint64_t escaped=find_escaped(b.backslash, escaped_carry);
+        uint64_t quote=b.quote & ~escaped;
+        uint64_t in_string=prefix_xor(quote) ^ in_string_carry; // opening quote included, closing one excluded
+        in_string_carry=uint64_t(int64_t(in_string)>>63);
+        // the earliest error of the block wins, whatever finds it
+        size_t limit=64;
+        const char *why=nullptr;
+        auto fault=[&](uint64_t bits, const char *what){
+          if(bits && size_t(std::countr_zero(bits))<limit) limit=std::countr_zero(bits), why=what;
+        };
+        auto below=[&]{ return limit<64? (uint64_t(1)<<limit)-1: ~uint64_t(0); };
+        // inside the strings: no control character, only the known escapes
+        fault(b.control & in_string, "control character in string");
+        for(uint64_t bits=escaped & in_string & below();bits;bits&=bits-1){
+          auto k=std::countr_zero(bits);
+          if(!escape(base+k)){
+            fault(uint64_t(1)<<k, "invalid escape");
+            break;
+          }
+        }
+        uint64_t strings=quote & in_string; // their opening quotes
+        if(in_string_carry && strings) string_start=base+63-std::countl_zero(strings);
+        uint64_t scalar=~(b.op | b.blank | quote | in_string);
+        uint64_t scalars=scalar & ~((scalar<<1) | scalar_carry);
+        scalar_carry=scalar>>63;
+        uint64_t op=b.op & ~in_string, open=b.open & op, close=b.close & op, colon=b.colon & op;
+        uint64_t comma=op & ~open & ~close & ~colon, tokens=op | strings | scalars;
+        // the brackets in order, with the bits where the innermost container turns object or not, top level or not
+        // the window is enough for the first 64 levels: no branch on open or close, no memory
+        size_t d=depth;
+        uint64_t w=window, objects_open=0, object_flips=0, top_flips=0;
+        bool was_object=w & 1, was_top=!d;
+        for(uint64_t bits=(open | close) & below();bits;bits&=bits-1){
+          auto k=std::countr_zero(bits);
+          uint64_t brace=raw[base+k]>>5 & 1, opening=open>>k & 1, before=w, top_before=!d; // {} against []
+          bool ok;
+          if(d<64){
+            ok=(opening & (d<max_depth)) | (!opening & (d>0) & ((w & 1)==brace));
+            w=(w>>1) ^ (((w<<1 | brace) ^ (w>>1)) & -opening);
+            d+=2*opening-1;
+          }else ok=deep(opening, brace, d, w);
+          if(!ok){
+            fault(uint64_t(1)<<k, opening? "nesting too deep": "mismatched bracket");
+            break;
+          }
+          objects_open|=(opening & brace)<<k;
+          object_flips|=((before ^ w) & 1)<<k;
+          top_flips|=uint64_t(top_before!=!d)<<k;
+        }
+        depth=d, window=w;
+        uint64_t in_object=-uint64_t(was_object), at_top=-uint64_t(was_top);
+        if(object_flips | top_flips) in_object^=prefix_xor(object_flips), at_top^=prefix_xor(top_flips);
+        // the token after each of a kind, the carry telling whether it is in the next block
+        uint64_t gaps=~tokens;
+        auto next=[&](uint64_t kind, uint64_t &carry){
+          uint64_t sum;
+          bool over=__builtin_add_overflow((kind<<1) | carry, gaps, &sum);
+          carry=over | kind>>63;
+          return sum & tokens;
+        };
+        uint64_t values=open | strings | scalars;
+        uint64_t after_object=next(objects_open, object_carry), after_array=next(open & ~objects_open, array_carry);
+        uint64_t after_key_comma=next(comma & in_object, key_carry), after_value_comma=next(colon | (comma & ~in_object), value_carry);
+        uint64_t keys=(after_object | after_key_comma) & strings;
+        uint64_t after_key=next(keys, colon_carry), after_value=next((strings & ~keys) | scalars | close, end_carry);
+        uint64_t ends=after_value & ~(comma | close), top_level=(at_top<<1) | was_top;
+        if((after_object & ~(strings | close)) | (after_array & ~(values | close)) | (after_key_comma & ~strings)
+          | (after_value_comma & ~values) | (after_key & ~colon) | ends | (comma & at_top)){
+          fault(after_object & ~(strings | close), "expected a string key");
+          fault(after_array & ~(values | close), "expected a value");
+          fault(after_key_comma & ~strings, "expected a string key");
+          fault(after_value_comma & ~values, "expected a value");
+          fault(after_key & ~colon, "expected a colon");
+          fault(ends & ~top_level, "expected a comma or a closing bracket");
+          fault((ends & top_level) | (comma & at_top), "content after the document");
+        }
+        // a scalar left by the blocks before ends first, and nothing goes wrong before it does
+        if(pending!=string_view::npos){
+          auto run=std::countr_one(scalar);
+          if(run<64){
+            size_t len=base+run-pending;
+            bool ok=len<64 && plain_number(raw.data()+pending, 0, len, pending_digit | b.digit<<(base-pending));
+            if(!ok && !token(pending, base+run)) return false;
+            pending=string_view::npos;
+          }
+        }
+        for(uint64_t bits=scalars & below();bits;bits&=bits-1){
+          auto k=std::countr_zero(bits);
+          auto run=k+std::countr_one(scalar>>k);
+          // one running into the next block is checked there, where it ends
+          if(run==64) pending=base+k, pending_digit=b.digit>>k;
+          else if(!plain_number(raw.data()+base, k, run, b.digit) && !token(base+k, base+run)) return false;
+        }
+        return !why || fail(why, base+limit);
+      }
+
+      // the last partial block is padded with blanks, never read past the input
+      bool tail(size_t i, block (*classify)(const char *)){
+        if(i>=raw.size()) return true;
+        char buf[64];
+        std::fill(std::begin(buf), std::end(buf), ' ');
+        std::copy(raw.begin()+i, raw.end(), buf);
+        return step(classify(buf), i);
+      }
+
+      validation finish(){
+        if(res.error || (pending!=string_view::npos && !token(pending, raw.size()))) return res;
+        if(in_string_carry) fail("unclosed string", string_start);
+        else if(depth || object_carry | array_carry | key_carry | value_carry | colon_carry)
+          fail(raw.empty()? "empty input": "unexpected end", raw.size());
+        return res;
+      }
+
+    private:
+      string_view raw;
+      size_t max_depth, depth=0, string_start=0;
+      uint64_t window=0; // bit set: the container is an object, for the innermost 64 levels, the innermost one in bit 0
+      uint64_t escaped_carry=0, in_string_carry=0, scalar_carry=0;
+      size_t pending=string_view::npos; // where a scalar running into the next block starts
+      uint64_t pending_digit=0; // its digit bits so far
+      // the token after a {, a [, a comma in an object, a colon or another comma (or the start), a key and a value
+      // is in a next block; all but the last are owed one
+      uint64_t object_carry=0, array_carry=0, key_carry=0, value_carry=1, colon_carry=0, end_carry=0;
+      uint64_t objects[depth_limit/64]{}; // past the window: bit d set, the container at depth d is an object
+      std::vector<uint64_t> deeper{}; // the same past depth_limit
+      validation res{};
+
+      uint64_t &objects_word(size_t d){
+        if(d<depth_limit) return objects[d/64];
+        if((d-depth_limit)/64>=deeper.size()) deeper.push_back(0);
+        return deeper[(d-depth_limit)/64];
+      }
+
+      bool fail(const char *why, size_t at){
+        res.error=why, res.offset=at;
+        return false;
+      }
+
+      bool hex(size_t i) const {
+        return i<raw.size() && std::isxdigit(uint8_t(raw[i]));
+      }
+
+      // i on the character after a backslash
+      bool escape(size_t i) const {
+        if(i>=raw.size()) return true; // the string is not closed either, that is the error
+        switch(raw[i]){
+          case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't': return true;
+          case 'u': return hex(i+1) && hex(i+2) && hex(i+3) && hex(i+4);
+          default: return false;
+        }
+      }
+
+      // a literal, or -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? from i up to the delimiter at `last`
+      bool token(size_t i, size_t last){
+        const char *why=nullptr;
+        auto bad=check_token(raw.substr(i, last-i), why);
+        return bad==string_view::npos || fail(why, i+bad);
+      }
+
+      // a valid number from k to end in the block at p, found from the digit bits alone
+      // anything else, literals and errors included, is left to token
+      static bool plain_number(const char *p, size_t k, size_t end, uint64_t digit){
+        size_t i=k+(p[k]=='-'), first=i;
+        auto digits=[&]{
+          auto n=std::countr_one(digit>>i);
+          i+=n;
+          return n>0;
+        };
+        if(!digits() || (p[first]=='0' && i>first+1)) return false;
+        if(i<end && p[i]=='.' && (++i, !digits())) return false;
+        if(i<end && (p[i]=='e' || p[i]=='E')){
+          ++i;
+          if(i<end && (p[i]=='+' || p[i]=='-')) ++i;
+          if(!digits()) return false;
+        }
+        return i==end;
+      }
+
+      // a bracket past the first 64 levels, the bits leaving the window kept in objects
+      bool deep(bool opening, bool brace, size_t &d, uint64_t &w){
+        if(opening){
+          if(d>=max_depth) return false;
+          auto &word=objects_word(d-64);
+          auto bit=uint64_t(1)<<((d-64)%64);
+          word=w>>63? word | bit: word & ~bit;
+          w=w<<1 | brace;
+          ++d;
+          return true;
+        }
+        if((w & 1)!=brace) return false;
+        --d;
+        w=w>>1 | uint64_t(d>=64 && (objects_word(d-64)>>((d-64)%64) & 1))<<63;
+        return true;
+      }
+    };
+
+    template<block (*classify)(const char *)>
+    inline void validate_blocks(string_view raw, validator &v){
+      size_t i=0;
+      for(;i+64<=raw.size();i+=64) if(!v.step(classify(raw.data()+i), i)) return;
+      v.tail(i, classify);
+    }
+
+#ifdef XJSON_X86
+    __attribute__((target("avx2")))
+    inline void validate_blocks_avx2(string_view raw, validator &v){
+      size_t i=0;
+      for(;i+64<=raw.size();i+=64) if(!v.step(classify_avx2(raw.data()+i), i)) return;
+      v.tail(i, classify_avx2);
+    }
+#endif
+
+    // the first error of raw, the earliest of the grammar and the utf-8 ones
+    // nothing is allocated unless the input nests deeper than validator::depth_limit
+    inline validation validate(string_view raw, size_t max_depth=1024, kernel k=kernel::automatic){
+      validator v(raw, max_depth);
+#ifdef XJSON_X86
+      static const bool avx2=supported(kernel::avx2);
+      if(k==kernel::automatic) k=avx2? kernel::avx2: kernel::sse2;
+      if(k==kernel::avx2) validate_blocks_avx2(raw, v);
+      else if(k==kernel::sse2) validate_blocks<classify_sse2>(raw, v);
+      else
+#endif
+      validate_blocks<classify_scalar>(raw, v);
+      auto res=v.finish();
+      if(auto bad=utf8_error(raw, k);bad!=string_view::npos && (res || bad<res.offset)) res={"invalid utf-8", bad};
+      return res;
+    }
+
+    // stage 2: build the tree, jumping from one structural position to the next
+    class reader{
+    public:
+      reader(string_view _raw, const index &idx, const options &_opt):
+        raw(_raw), it(idx.pos.get()), end(idx.pos.get()+idx.size), opt(_opt),
+        alloc(opt.resource? opt.resource: std::pmr::get_default_resource()){}
+      reader(const reader &)=delete;
+      reader &operator=(const reader &)=delete;
+
+      // where the next value starts, or the end of the input
+      size_t offset() const {
+        return it<end? *it: raw.size();
+      }
+
+      // the whole value under the cursor: containers are read with an explicit stack instead of recursion,
+      // their members collected on the scratch stacks so each container is allocated once at its final size
+      json value(){
+        auto base=values.size();
+        // the text of a container is retained only when it is json as it is: a value read the lenient way
+        // marks the innermost container, and a container not retained its parent
+        for(;;){
+          auto begin=peek();
+          if(begin=='{' || begin=='['){
+            if(frames.size()>=opt.max_depth)
+              throw std::invalid_argument(std::format("invalid json: nesting too deep at byte {}", *it));
+            frames.push_back({*it, values.size(), keys.size(), begin=='{'});
+            counts.max_depth=std::max(counts.max_depth, frames.size());
+            ++it;
+            if(next()) continue;
+            close();
+          }else if(it<end && begin!='}' && begin!=']' && begin!=',' && begin!=':') scalar(values.emplace_back());
+          else values.emplace_back(), lenient(); // a missing value
+          // a complete value on top of the stack: close the containers that end right after it
+          for(;;){
+            if(frames.empty()){
+              auto j=std::move(values.back());
+              values.resize(base);
+              return j;
+            }
+            auto sep=peek();
+            if(sep==',' || (sep==':' && !frames.back().object)) ++it;
+            bool more=next();
+            if(more? sep!=',': sep==',' || sep==':') lenient(); // a missing or trailing comma, a stray colon
+            if(more) break;
+            close();
+          }
+        }
+      }
+
+      // the counters so far, the times and the index are the caller's
+      const stats &counted() const {
+        return counts;
+      }
+
+    private:
+      string_view raw;
+      const uint32_t *it, *end;
+      const options &opt;
+      std::pmr::polymorphic_allocator<> alloc;
+      // a container being read: where it starts, and where its members start on the scratch stacks
+      struct frame{
+        size_t bpos, base, kbase;
+        bool object;
+        bool dirty=false; // something in it was read the lenient way
+      };
+      std::vector<frame> frames{};
+      std::vector<json> values{}; // scratch stacks of the containers being read
+      std::vector<key> keys{};
+      stats counts{};
+      std::string scratch{}; // escaped strings are decoded here first
+      // one key per distinct key of the document, open addressing, at most half full
+      std::vector<key> interned{};
+      size_t interned_count=0;
+
+      // whether the innermost container has another member: its key is read here
+      bool next(){
+        if(frames.back().object){
+          if(peek()!='"') return false;
+          auto k=str();
+          if(opt.retain && !exact_string(k)) lenient();
+          keys.push_back(intern(decoded(k)));
+          if(peek()==':') ++it;
+          else lenient();
+          return true;
+        }
+        return it<end && peek()!=']' && peek()!='}';
+      }
+
+      // the innermost container, made from the members on top of the scratch stacks, and put in their place
+      void close(){
+        auto f=frames.back();
+        frames.pop_back();
+        json j;
+        auto &v=j.val;
+        bool exact=!f.dirty && peek()==(f.object? '}': ']');
+        if(exact) retain(j, f.bpos, *it+1);
+        else lenient();
+        if(f.object){
+          if(it<end) ++it; // }
+          auto &o=v.emplace<object_t>(alloc);
+          o.reserve(keys.size()-f.kbase);
+          for(auto i=f.kbase;i<keys.size();++i)
+            o.insert(std::move(keys[i]), std::move(values[f.base+i-f.kbase]));
+          keys.resize(f.kbase);
+          ++counts.objects;
+          counts.allocations+=!o.empty();
+        }else{
+          if(it<end) ++it; // ]
+          auto &a=v.emplace<array_t>(alloc);
+          a.reserve(values.size()-f.base);
+          std::move(values.begin()+f.base, values.end(), std::back_inserter(a));
+          ++counts.arrays;
+          counts.allocations+=!a.empty();
+        }
+        values.resize(f.base);
+        values.push_back(std::move(j));
+      }
+
+      // the value under the cursor into j, when it is not a container
+      void scalar(json &j){
+        auto &v=j.val;
+        auto bpos=*it;
+        if(raw[bpos]=='"'){
+          auto s=str();
+          if(opt.retain){
+            if(s.data()+s.size()<raw.data()+raw.size() && exact_string(s)) retain(j, bpos, s.data()+s.size()+1-raw.data());
+            else lenient();
+          }
+          v=string_value(s);
+          ++counts.strings;
+          return;
+        }
+        ++it;
+        auto epos=offset();
+        while(epos>bpos && is_blank(raw[epos-1])) --epos;
+        auto token=raw.substr(bpos, epos-bpos);
+        if(opt.retain){
+          const char *why=nullptr;
+          if(check_token(token, why)==string_view::npos) retain(j, bpos, epos);
+          else lenient(); // tru, 01, or a token regarded as a string
+        }
+        auto begin=raw[bpos];
+        if(begin=='t' || begin=='f'){ // true, false
+          v=begin=='t';
+          ++counts.booleans;
+        }else if(begin=='n'){ // null
+          v=nullptr;
+          ++counts.nulls;
+        }else{ // number or string
+          auto n=parse_number(token);
+          ++counts.numbers;
+          if(n.type==number::integer) v=n.i;
+          else if(n.type==number::unsigned_integer) v=n.u;
+          else if(n.type==number::real) v=n.d;
+          else{
+            v=string_value(token); // regarded as String
+            j.changed(); // and written as one
+            --counts.numbers, ++counts.strings;
+          }
+        }
+      }
+
+      void lenient(){
+        if(!frames.empty()) frames.back().dirty=true;
+      }
+
+      // j is raw[b, e)
+      void retain(json &j, size_t b, size_t e){
+        if(!opt.retain || e-b>UINT32_MAX) return;
+        j.src=raw.data()+b;
+        j.src_size=e-b;
+      }
+
+      key intern(string_view str){
+        auto hash=std::hash<string_view>{}(str);
+        if(interned_count*2>=interned.size()) grow_interned();
+        auto mask=interned.size()-1;
+        for(auto s=hash & mask;;s=(s+1) & mask){
+          auto &k=interned[s];
+          if(!k.r){
+            k=key(str, hash, alloc.resource());
+            ++interned_count, ++counts.allocations;
+            return k.share();
+          }
+          if(k.hash()==hash && k.view()==str) return k.share();
+        }
+      }
+
+      void grow_interned(){
+        std::vector<key> old(std::max<size_t>(64, interned.size()*2));
+        old.swap(interned);
+        auto mask=interned.size()-1;
+        for(auto &k: old){
+          if(!k.r) continue;
+          auto s=k.hash() & mask;
+          while(interned[s].r) s=(s+1) & mask;
+          interned[s]=std::move(k);
+        }
+      }
+
+      // the escapes are decoded once, here: a string without any is still borrowed
+      json::variant string_value(string_view str){
+        auto text=decoded(str);
+        if(opt.borrow && text.data()==str.data()) return str;
+        str=text;
+        if(opt.resource){
+          ++counts.allocations;
+          auto buf=static_cast<char *>(opt.resource->allocate(str.size(), 1));
+          return string_view(buf, std::copy(str.begin(), str.end(), buf));
+        }
+        static const size_t inline_size=string().capacity();
+        counts.allocations+=str.size()>inline_size; // past the inline buffer
+        return string(str);
+      }
+
+      // str itself without a backslash, decoded into the scratch buffer otherwise (valid until the next call)
+      string_view decoded(string_view str){
+        if(!std::memchr(str.data(), '\\', str.size())) return str;
+        if(scratch.size()<str.size()+16) scratch.resize(str.size()+16);
+        return string_view(scratch.data(), unescape(str, scratch.data()));
+      }
+
+      char peek() const {
+        return it<end? raw[*it]: '\0';
+      }
+
+      // the string between the quote under the cursor and the closing one
+      string_view str(){
+        auto bpos=*it+1;
+        ++it;
+        auto epos=offset();
+        if(it<end) ++it;
+        return raw.substr(bpos, epos-bpos);
+      }
+    };
+
+    inline json parse(string_view &raw, const options &opt){
+      // the clock is read only when the stats are wanted
+      using clock=std::chrono::steady_clock;
+      auto now=[&]{ return opt.stats? clock::now(): clock::time_point(); };
+      auto t0=now();
+      if(opt.strict)
+        if(auto v=validate(raw, opt.max_depth);!v) throw std::invalid_argument(std::format("invalid json: {} at byte {}", v.error, v.offset));
+      auto t1=now();
+      // one value is read: the rest of the input is left to the next call, not indexed each time
+      auto idx=build_index(raw, kernel::automatic, true);
+      auto t2=now();
+      std::optional<reader> r;
+      r.emplace(raw, idx, opt);
+      auto j=r->value();
+      // the reader closes a container no later than its brackets do, so it stops within the index:
+      // should it still run out of positions before the end of the input, it reads again from all of it
+      if(idx.bytes<raw.size() && r->offset()==raw.size()){
+        idx=build_index(raw);
+        r.emplace(raw, idx, opt);
+        j=r->value();
+      }
+      if(auto st=opt.stats){
+        *st=r->counted();
+        st->validate=opt.strict? t1-t0: clock::duration(), st->index=t2-t1, st->build=now()-t2;
+        st->bytes=r->offset();
+        ++st->allocations; // the index
+      }
+      raw.remove_prefix(r->offset());
+      return j;
+    }
+  }
+
+  using parser::validation;
+  using parser::validate;
+
+
+  // serializes into one buffer: the caller's string, or 64 KiB drained into a stream, a FILE * or a file descriptor
+  // indent>0 pretty prints with that many spaces per level
+  // key() and string() escape their text, raw_key() and raw_string() take it already escaped, like the strings of a json
+  class writer{
+  public:
+    struct descriptor{
+      int fd;
+    };
+
+    explicit writer(std::string &_out, size_t _indent=0): out(&_out), indent(_indent){}
+
+    explicit writer(std::ostream &os, size_t _indent=0): writer(&os, [](writer &w){
+      static_cast<std::ostream *>(w.target)->write(w.own.data(), w.own.size());
+    }, _indent){}
+
+    explicit writer(FILE *file, size_t _indent=0): writer(file, [](writer &w){
+      if(std::fwrite(w.own.data(), 1, w.own.size(), static_cast<FILE *>(w.target))!=w.own.size())
+        throw std::system_error(errno, std::generic_category(), "json writer");
+    }, _indent){}
+
+#ifdef XJSON_POSIX
+    explicit writer(descriptor d, size_t _indent=0): writer(nullptr, [](writer &w){
+      for(size_t done=0;done<w.own.size();){
+        auto n=::write(w.fd, w.own.data()+done, w.own.size()-done);
+        if(n<0 && errno==EINTR) continue;
+        if(n<0) throw std::system_error(errno, std::generic_category(), "json writer");
+        done+=n;
+      }
+    }, _indent){
+      fd=d.fd;
+    }
+#endif
+
+    writer(const writer &)=delete;
+    writer &operator=(const writer &)=delete;
+
+    // the errors of the last flush are lost here, call flush() to see them
+    ~writer(){
+      try{
+        flush();
+      }catch(...){}
+    }
+
+    // hand the buffered text to the sink
+    void flush(){
+      if(!drain || own.empty()) return;
+      drain(*this);
+      own.clear();
+    }
+
+    writer &start_object(){ return open('{'); }
+    writer &end_object(){ return close('}'); }
+    writer &start_array(){ return open('['); }
+    writer &end_array(){ return close(']'); }
+
+    writer &key(std::string_view k){
+      begin_key();
+      escape(k);
+      return end_key();
+    }
+
+    writer &raw_key(std::string_view k){
+      begin_key();
+      out->append(k);
+      return end_key();
+    }
+
+    writer &string(std::string_view str){
+      separate();
+      out->push_back('"');
+      escape(str);
+      out->push_back('"');
+      return spill();
+    }
+
+    writer &raw_string(std::string_view str){
+      separate();
+      out->push_back('"');
+      out->append(str);
+      out->push_back('"');
+      return spill();
+    }
+
+    writer &number(long long i){
+      separate();
+      char buf[24];
+      out->append(buf, std::to_chars(buf, std::end(buf), i).ptr);
+      return spill();
+    }
+
+    writer &number(unsigned long long u){
+      separate();
+      char buf[24];
+      out->append(buf, std::to_chars(buf, std::end(buf), u).ptr);
+      return spill();
+    }
+
+    template<Integer T>
+    writer &number(T i){
+      if constexpr(std::is_signed_v<T>) return number(static_cast<long long>(i));
+      else return number(static_cast<unsigned long long>(i));
+    }
+
+    // the shortest text that reads back to the same double
+    writer &number(double d){
+      separate();
+      if(!std::isfinite(d)){ // no such thing in json
+        out->append("null");
+        return spill();
+      }
+      char buf[32];
+      auto end=std::to_chars(buf, std::end(buf), d).ptr;
+      out->append(buf, end);
+      if(std::find_if(buf, end, [](char c){ return c=='.' || c=='e'; })==end) out->append(".0"); // still a double when read back
+      return spill();
+    }
+
+    writer &boolean(bool b){
+      separate();
+      out->append(b? "true": "false");
+      return spill();
+    }
+
+    writer &null(){
+      separate();
+      out->append("null");
+      return spill();
+    }
+
+    // text that is json already, written as it is
+    writer &raw(std::string_view text){
+      separate();
+      out->append(text);
+      return spill();
+    }
+
+    // a whole json
+    // an unchanged value of a retained parse is copied from the input, unless pretty printing
+    writer &value(const json &j){
+      if(j.src && !indent) return raw(j.source());
+      if(j.is_object()){
+        start_object();
+        for(auto &[k, child]: j.get_const_object()) key(k).value(child);
+        return end_object();
+      }
+      if(j.is_array()){
+        start_array();
+        for(auto &child: j.get_const_array()) value(child);
+        return end_array();
+      }
+      if(j.is_string()) return string(j.get_raw());
+      if(j.is_unsigned()) return number(j.getc<unsigned long long>());
+      if(j.is_integer()) return number(j.getc<long long>());
+      if(j.is_double()) return number(j.getc<double>());
+      if(j.is_bool()) return boolean(j.getc<bool>());
+      return null();
+    }
+
+  private:
+    static constexpr size_t capacity=1<<16;
+
+    std::string *out; // where the text goes: the caller's string, or `own` before it is drained
+    std::string own{};
+    void *target=nullptr;
+    void (*drain)(writer &)=nullptr;
+    int fd=-1;
+    size_t indent, depth=0;
+    bool first=true, after_key=false;
+
+    writer(void *_target, void (*_drain)(writer &), size_t _indent): out(&own), target(_target), drain(_drain), indent(_indent){
+      own.reserve(capacity+capacity/4);
+    }
+
+    writer &spill(){
+      if(drain && own.size()>=capacity) flush();
+      return *this;
+    }
+
+    // the comma and the line break before a value or a key
+    void separate(){
+      if(after_key){
+        after_key=false;
+        return;
+      }
+      if(depth){
+        if(!first) out->push_back(',');
+        if(indent) newline(depth);
+      }
+      first=false;
+    }
+
+    void newline(size_t level){
+      out->push_back('\n');
+      out->append(level*indent, ' ');
+    }
+
+    writer &open(char bracket){
+      separate();
+      out->push_back(bracket);
+      ++depth, first=true;
+      return *this;
+    }
+
+    writer &close(char bracket){
+      --depth;
+      if(indent && !first) newline(depth);
+      out->push_back(bracket);
+      first=false;
+      return spill();
+    }
+
+    void begin_key(){
+      separate();
+      out->push_back('"');
+    }
+
+    writer &end_key(){
+      out->append(indent? "\": ": "\":");
+      after_key=true;
+      return *this;
+    }
+
+    // the first byte from i on that must be escaped: " \ or a control character
+    static size_t clean(std::string_view str, size_t i){
+#ifdef XJSON_X86
+      for(;i+16<=str.size();i+=16){
+        auto in=_mm_loadu_si128(reinterpret_cast<const __m128i *>(str.data()+i));
+        auto control=_mm_cmpeq_epi8(_mm_max_epu8(in, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+        auto special=_mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('"')), _mm_cmpeq_epi8(in, _mm_set1_epi8('\\')));
+        if(auto bits=unsigned(_mm_movemask_epi8(_mm_or_si128(control, special)))) return i+std::countr_zero(bits);
+      }
+#endif
+      for(;i<str.size();++i){
+        auto c=uint8_t(str[i]);
+        if(c=='"' || c=='\\' || c<0x20) return i;
+      }
+      return i;
+    }
+
+    void escape(std::string_view str){
+      for(size_t i=0;;){
+        auto j=clean(str, i);
+        out->append(str.data()+i, j-i);
+        if(j==str.size()) return;
+        switch(str[j]){
+          case '"': out->append("\\\""); break;
+          case '\\': out->append("\\\\"); break;
+          case '\b': out->append("\\b"); break;
+          case '\f': out->append("\\f"); break;
+          case '\n': out->append("\\n"); break;
+          case '\r': out->append("\\r"); break;
+          case '\t': out->append("\\t"); break;
+          default:
+            out->append("\\u00");
+            out->push_back("0123456789abcdef"[uint8_t(str[j])>>4]);
+            out->push_back("0123456789abcdef"[str[j] & 0xf]);
+        }
+        i=j+1;
+      }
+    }
+  };
+
+  inline json::operator std::string() const {
+    if(is_string()) return std::string(get_raw());
+    std::string res;
+    writer(res).value(*this);
+    return res;
+  }
+
+  inline std::string json::dump(size_t indent) const {
+    std::string res;
+    writer(res, indent).value(*this);
+    return res;
+  }
+
+
+  // a compiled json pointer (RFC 6901): "/result/songs/3/name", where ~1 and ~0 stand for / and ~
+  // every segment keeps its hash for objects and its number for arrays
+  // two extensions select many values: "*" is every member or element, "a:b" the elements a to b-1,
+  // either bound may be left out; on an object, a slice is an ordinary key
+  class path{
+  public:
+    path(std::string_view pointer){
+      if(!pointer.empty() && pointer[0]!='/') throw std::invalid_argument(std::format("invalid json pointer: {}", pointer));
+      while(!pointer.empty()){
+        pointer.remove_prefix(1);
+        auto end=std::min(pointer.find('/'), pointer.size());
+        add(pointer.substr(0, end));
+        pointer.remove_prefix(end);
+      }
+    }
+
+    path(const char *pointer): path(std::string_view(pointer)){}
+    path(const std::string &pointer): path(std::string_view(pointer)){}
+
+    // f(const json &) on every value at this path, in document order
+    template<typename F>
+    void for_each(const json &root, F &&f) const {
+      auto all=[&](const json &j){
+        f(j);
+        return true;
+      };
+      walk(root, 0, all);
+    }
+
+    const json *find(const json &root) const {
+      const json *res=nullptr;
+      auto first=[&](const json &j){
+        res=&j;
+        return false;
+      };
+      walk(root, 0, first);
+      return res;
+    }
+
+    // the containers on the way are accessed as non const, see json::source()
+    json *find(json &root) const {
+      json *res=nullptr;
+      auto first=[&](json &j){
+        res=&j;
+        return false;
+      };
+      walk(root, 0, first);
+      return res;
+    }
+
+  private:
+    friend class shared::node;
+    friend class shared::document;
+
+    static constexpr size_t npos=size_t(-1);
+
+    struct segment{
+      enum kind{ member, wildcard, slice } type;
+      std::string name;
+      size_t hash;
+      size_t index, end; // member: the index if the name is a number, else npos; slice: [index, end)
+    };
+
+    std::vector<segment> segments{};
+
+    template<typename J>
+    static auto &object_of(J &j){
+      if constexpr(std::is_const_v<J>) return j.get_const_object();
+      else return j.get_object();
+    }
+
+    template<typename J>
+    static auto &array_of(J &j){
+      if constexpr(std::is_const_v<J>) return j.get_const_array();
+      else return j.get_array();
+    }
+
+    // a number without sign nor leading zero, or npos
+    static size_t number(std::string_view str){
+      size_t n=npos;
+      if(str.empty() || (str.size()>1 && str[0]=='0')) return n;
+      auto res=std::from_chars(str.data(), str.data()+str.size(), n);
+      return res.ec==std::errc() && res.ptr==str.data()+str.size()? n: npos;
+    }
+
+    void add(std::string_view raw){
+      segment s{segment::member, {}, 0, npos, npos};
+      for(size_t i=0;i<raw.size();++i){
+        if(raw[i]=='~' && i+1<raw.size() && (raw[i+1]=='0' || raw[i+1]=='1')) s.name.push_back(raw[++i]=='0'? '~': '/');
+        else s.name.push_back(raw[i]);
+      }
+      s.hash=hashed_key(s.name).hash;
+      auto colon=raw.find(':');
+      if(raw=="*") s.type=segment::wildcard;
+      else if(colon!=raw.npos){
+        auto begin=raw.substr(0, colon), end=raw.substr(colon+1);
+        s.index=begin.empty()? 0: number(begin);
+        s.end=end.empty()? npos-1: number(end);
+        if(s.index!=npos && s.end!=npos) s.type=segment::slice;
+        else s.index=s.end=npos;
+      }else s.index=number(raw);
+      segments.push_back(std::move(s));
+    }
+
+    // f returns false to stop, and so does walk
+    // J: json or const json
+    template<typename J, typename F>
+    bool walk(J &j, size_t k, F &f) const {
+      if(k==segments.size()) return f(j);
+      auto &s=segments[k];
+      if(j.is_object()){
+        auto &obj=object_of(j);
+        if(s.type==segment::wildcard){
+          for(auto &[key, child]: obj)
+            if(!walk(child, k+1, f)) return false;
+          return true;
+        }
+        auto it=obj.find(hashed_key(s.name, s.hash));
+        return it==obj.end() || walk(it->second, k+1, f);
+      }
+      if(j.is_array()){
+        auto &arr=array_of(j);
+        size_t begin=0, end=arr.size();
+        if(s.type==segment::member) begin=s.index, end=s.index==npos? s.index: s.index+1;
+        else if(s.type==segment::slice) begin=s.index, end=s.end;
+        for(auto i=begin;i<std::min(end, arr.size());++i)
+          if(!walk(arr[i], k+1, f)) return false;
+      }
+      return true;
+    }
+  };
+
+  inline const json *json::find(const path &p) const {
+    return p.find(*this);
+  }
+
+  inline json *json::find(const path &p){
+    return p.find(*this);
+  }
+
+  inline const json &json::at(const path &p) const {
+    if(auto res=find(p)) return *res;
+    throw std::out_of_range("path not found");
+  }
+
+  inline json &json::at(const path &p){
+    if(auto res=find(p)) return *res;
+    throw std::out_of_range("path not found");
+  }
+
+  inline std::vector<const json *> json::select(const path &p) const {
+    std::vector<const json *> res;
+    p.for_each(*this, [&](const json &j){ res.push_back(&j); });
+    return res;
+  }
+
+  // a json whose strings are views into the input, which the document keeps alive
+  // note: values copied out of a document still borrow from its buffer
+  // with an arena, every node is allocated from it and dropping the document does not walk the tree,
+  // the memory comes back with the arena's release(), so the arena must outlive the document
+  // values a change puts in the tree live on the heap: once changed, the tree is dropped the usual way
+  class document: public json{
+  private:
+    std::shared_ptr<const void> holder{};
+    std::pmr::memory_resource *arena=nullptr;
+
+    // the tree, without walking it when it is all in the arena
+    void drop(){
+      if(arena && marked()) abandon();
+      else val=nullptr;
+    }
+
+    // strings are always borrowed, opt.resource is the arena
+    static json borrowed(std::string_view raw, parser::options opt){
+      opt.borrow=true;
+      return parser::parse(raw, opt);
+    }
+
+    // the strings of a copy that are views, copied too: they may point into the arena
+    static void own_strings(json &j){
+      if(auto view=std::get_if<string_view>(&j.val)) j.val=std::string(*view);
+      else if(auto obj=std::get_if<object_t>(&j.val)) for(auto &[k, child]: *obj) own_strings(child);
+      else if(auto arr=std::get_if<array_t>(&j.val)) for(auto &child: *arr) own_strings(child);
+    }
+
+    static json copy(const document &other){
+      json res(other);
+      if(other.arena) own_strings(res);
+      return res;
+    }
+
+    document(std::shared_ptr<const std::string> buf, const parser::options &opt):
+      json(borrowed(*buf, opt)), holder(std::move(buf)), arena(opt.resource){
+      mark();
+    }
+
+  public:
+    document()=default;
+    document(document &&)=default;
+
+    // a copy lives on the default heap, strings included: it does not need the arena
+    document(const document &other): json(copy(other)), holder(other.holder), arena(nullptr){}
+
+    document &operator=(const document &other){
+      if(this!=&other){
+        drop();
+        json::operator=(copy(other));
+        holder=other.holder;
+        arena=nullptr;
+      }
+      return *this;
+    }
+
+    document &operator=(document &&other){
+      if(this!=&other){
+        // a container moved into one of another allocator would be copied there, so this one goes first
+        drop();
+        json::operator=(static_cast<json &&>(other));
+        holder=std::move(other.holder);
+        arena=other.arena;
+      }
+      return *this;
+    }
+
+    explicit document(std::string raw, std::pmr::memory_resource *_arena=nullptr):
+      document(std::move(raw), parser::options{.resource=_arena}){}
+
+    // `raw` must stay valid as long as `_holder` is alive, or as long as the document if there is no holder
+    document(std::string_view raw, std::shared_ptr<const void> _holder, std::pmr::memory_resource *_arena=nullptr):
+      document(raw, std::move(_holder), parser::options{.resource=_arena}){}
+
+    // strings are always borrowed, opt.resource is the arena
+    // e.g. document(std::move(body), {.retain=true}): change a field or two, dump() copies the rest from the input
+    // the root is made in place, in the arena like the rest of the tree
+    document(std::string raw, const parser::options &opt):
+      document(std::make_shared<const std::string>(std::move(raw)), opt){}
+
+    document(std::string_view raw, std::shared_ptr<const void> _holder, const parser::options &opt):
+      json(borrowed(raw, opt)), holder(std::move(_holder)), arena(opt.resource){
+      mark();
+    }
+
+    ~document(){
+      drop();
+    }
+  };
+
+  // builds a tree front to back, each value made in place in its parent: nothing is copied or moved up
+  // e.g. builder b;
+  //      b.begin_object().key("id").value(1).key("tags").begin_array().value("a").end_array().end_object();
+  //      json j=std::move(b.result());
+  // a repeated key replaces the earlier value
+  class builder{
+  public:
+    builder()=default;
+    builder(const builder &)=delete;
+    builder &operator=(const builder &)=delete;
+
+    builder &begin_object(){
+      open(object_t());
+      return *this;
+    }
+
+    builder &begin_array(){
+      open(array_t());
+      return *this;
+    }
+
+    builder &end_object(){
+      close(true);
+      return *this;
+    }
+
+    builder &end_array(){
+      close(false);
+      return *this;
+    }
+
+    // the key of the next value, the member is made right away
+    // a key is allocated once and shared by every object of the tree, like the parser's
+    builder &key(std::string_view k){
+      if(stack.empty() || !stack.back()->is_object() || slot) throw std::logic_error("builder: a key outside of an object");
+      auto it=keys.find(k);
+      if(it==keys.end()){
+        xihale::json::key made(k);
+        auto view=made.view();
+        it=keys.emplace(view, std::move(made)).first;
+      }
+      slot=&stack.back()->get_object().emplace(it->second).first->second;
+      return *this;
+    }
+
+    // a number, a bool, nullptr, a string (copied, a string_view too) or a whole json
+    template<typename T>
+    builder &value(T &&v){
+      auto &j=place();
+      if constexpr(std::is_same_v<std::remove_cvref_t<T>, std::string_view>) j=std::string(v);
+      else j=std::forward<T>(v);
+      return *this;
+    }
+
+    // room for n more members or elements in the innermost container
+    builder &reserve(size_t n){
+      if(stack.empty()) return *this;
+      auto &top=*stack.back();
+      if(top.is_object()) top.get_object().reserve(top.get_const_object().size()+n);
+      else top.get_array().reserve(top.get_const_array().size()+n);
+      return *this;
+    }
+
+    // the root value is complete
+    bool done() const {
+      return started && stack.empty();
+    }
+
+    json &result(){
+      return root;
+    }
+
+  private:
+    json root{};
+    std::vector<json *> stack{}; // the containers being built, innermost last
+    json *slot=nullptr; // the member made by key()
+    bool started=false;
+    std::unordered_map<std::string_view, xihale::json::key> keys{}; // viewed in their own bytes
+
+    json &place(){
+      if(stack.empty()){
+        if(started) throw std::logic_error("builder: a second root value");
+        started=true;
+        return root;
+      }
+      auto &top=*stack.back();
+      if(top.is_array()) return top.get_array().emplace_back();
+      if(!slot) throw std::logic_error("builder: a value without a key");
+      return *std::exchange(slot, nullptr);
+    }
+
+    template<typename T>
+    void open(T &&container){
+      auto &j=place();
+      j=std::forward<T>(container);
+      stack.push_back(&j);
+    }
+
+    void close(bool object){
+      if(stack.empty() || stack.back()->is_object()!=object || slot) throw std::logic_error("builder: unbalanced end");
+      stack.pop_back();
+    }
+  };
 }
 }
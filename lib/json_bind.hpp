@@ -0,0 +1,408 @@
+// Bind json to C++ types: parse straight into structs, write them straight out, without a json in between
+
+#pragma once
+
+#include "json.hpp"
+#include "json_ondemand.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace xihale{
+namespace json{
+
+  // the members of a struct, by their json name: specialize it, or use XJSON_BIND
+  //   template<> struct xihale::json::json_traits<point>{
+  //     static constexpr std::tuple members{bind::member("x", &point::x), bind::member("y", &point::y)};
+  //   };
+  template<typename T>
+  struct json_traits;
+
+namespace bind{
+
+  using std::string_view;
+
+  template<typename C, typename M>
+  struct member{
+    string_view name;
+    M C::*ptr;
+
+    constexpr member(string_view _name, M C::*_ptr): name(_name), ptr(_ptr){}
+  };
+
+  template<typename T>
+  concept Bound=requires{ json_traits<T>::members; };
+
+  template<typename T>
+  concept Optional=std::is_same_v<T, std::optional<typename T::value_type>>;
+
+  template<typename T>
+  concept Sequence=std::is_same_v<T, std::vector<typename T::value_type, typename T::allocator_type>>;
+
+  // a map with string keys, written as an object
+  template<typename T>
+  concept Map=requires{ typename T::mapped_type; } && std::is_convertible_v<typename T::key_type, string_view>
+    && std::is_constructible_v<typename T::key_type, string_view>;
+
+  // the input being read, p only moves forward
+  class cursor{
+  public:
+    cursor(const char *_p, const char *_end): p(_p), end(_end){}
+
+    // the next byte that is not blank, '\0' at the end
+    char peek(){
+      p=ondemand::skip_blank(p, end);
+      return p<end? *p: '\0';
+    }
+
+    bool consume(char ch){
+      if(peek()!=ch) return false;
+      ++p;
+      return true;
+    }
+
+    void expect(char ch){
+      if(!consume(ch)) fail();
+    }
+
+    // the raw (still escaped) string at p, `escaped` tells whether it has a backslash
+    string_view string(bool &escaped){
+      if(peek()!='"') fail();
+      auto begin=++p;
+      escaped=false;
+      for(auto q=p;;){
+        auto quote=static_cast<const char *>(std::memchr(q, '"', end-q));
+        if(!quote) fail();
+        auto backslash=static_cast<const char *>(std::memchr(q, '\\', quote-q));
+        if(!backslash){
+          p=quote+1;
+          return string_view(begin, quote-begin);
+        }
+        escaped=true;
+        q=backslash+2;
+        if(q>end) fail();
+      }
+    }
+
+    parser::number number(){
+      peek();
+      auto q=ondemand::skip_scalar(p, end);
+      auto n=parser::parse_number(string_view(p, q-p));
+      if(n.type==parser::number::invalid) fail();
+      p=q;
+      return n;
+    }
+
+    // true, false or null at p, false when it is something else
+    bool literal(string_view word){
+      peek();
+      if(size_t(end-p)<word.size() || string_view(p, word.size())!=word) return false;
+      p+=word.size();
+      return true;
+    }
+
+    // the raw text of the value at p, skipped
+    string_view skip(){
+      peek();
+      auto begin=p;
+      p=ondemand::skip_value(p, end);
+      if(p==begin) fail();
+      return string_view(begin, p-begin);
+    }
+
+    [[noreturn]] void fail() const {
+      ondemand::invalid(p, end);
+    }
+
+    [[noreturn]] void fail(string_view why) const {
+      throw std::invalid_argument(std::format("invalid json near `{}`: {}", string_view(p, std::min<size_t>(end-p, 16)), why));
+    }
+
+  private:
+    const char *p, *end;
+  };
+
+  // every reader and writer, so that they find each other whatever the nesting
+  inline void read(cursor &c, bool &v);
+  template<Integer T> inline void read(cursor &c, T &v);
+  template<std::floating_point T> inline void read(cursor &c, T &v);
+  inline void read(cursor &c, std::string &v);
+  inline void read(cursor &c, string_view &v);
+  inline void read(cursor &c, json &v);
+  template<Optional T> inline void read(cursor &c, T &v);
+  template<Sequence T> inline void read(cursor &c, T &v);
+  template<Map T> inline void read(cursor &c, T &v);
+  template<Bound T> inline void read(cursor &c, T &v);
+
+  inline void write(writer &w, bool v);
+  template<Integer T> inline void write(writer &w, T v);
+  template<std::floating_point T> inline void write(writer &w, T v);
+  template<String T> inline void write(writer &w, const T &v);
+  inline void write(writer &w, const json &v);
+  template<Optional T> inline void write(writer &w, const T &v);
+  template<Sequence T> inline void write(writer &w, const T &v);
+  template<Map T> inline void write(writer &w, const T &v);
+  template<Bound T> inline void write(writer &w, const T &v);
+
+  // a perfect hash of the member names, found at compile time: a seed for which no two names share a slot
+  template<size_t N>
+  struct perfect_hash{
+    static constexpr size_t size=std::bit_ceil(std::max<size_t>(N, 1)*(N>16? 8: 4));
+
+    uint64_t seed=0;
+    std::array<uint16_t, size> slots{}; // member index+1, 0 for none
+
+    static constexpr size_t slot(string_view name, uint64_t seed){
+      uint64_t h=0xcbf29ce484222325ull ^ seed; // fnv-1a
+      for(unsigned char ch: name) h=(h ^ ch)*0x100000001b3ull;
+      return (h ^ h>>32) & (size-1);
+    }
+
+    constexpr explicit perfect_hash(const std::array<string_view, N> &names){
+      for(size_t i=0;i<N;++i)
+        for(size_t k=0;k<i;++k)
+          if(names[i]==names[k]) throw std::invalid_argument("json_traits: two members with the same name");
+      for(;;++seed){
+        slots.fill(0);
+        size_t i=0;
+        for(;i<N && !slots[slot(names[i], seed)];++i) slots[slot(names[i], seed)]=i+1;
+        if(i==N) return;
+      }
+    }
+
+    // the index of the member called `name`, N for none
+    constexpr size_t find(const std::array<string_view, N> &names, string_view name) const {
+      if constexpr(N==0) return 0;
+      else{
+        auto i=slots[slot(name, seed)];
+        return i && names[i-1]==name? i-1: N;
+      }
+    }
+  };
+
+  // what is known of a bound struct at compile time: its member names, their hash, a reader per member
+  template<Bound T>
+  struct binding{
+    static constexpr auto &members=json_traits<T>::members;
+    static constexpr size_t count=std::tuple_size_v<std::remove_cvref_t<decltype(members)>>;
+
+    static constexpr auto names=[]<size_t... I>(std::index_sequence<I...>){
+      return std::array<string_view, count>{std::get<I>(members).name...};
+    }(std::make_index_sequence<count>());
+
+    static constexpr perfect_hash<count> hash{names};
+
+    // names that need no escaping are written as they are
+    static constexpr bool plain=[]{
+      for(auto name: names)
+        for(unsigned char ch: name)
+          if(ch<0x20 || ch=='"' || ch=='\\') return false;
+      return true;
+    }();
+
+    static constexpr auto readers=[]<size_t... I>(std::index_sequence<I...>){
+      return std::array<void (*)(cursor &, T &), count>{
+        +[](cursor &c, T &obj){ read(c, obj.*std::get<I>(members).ptr); }...
+      };
+    }(std::make_index_sequence<count>());
+  };
+
+  inline void read(cursor &c, bool &v){
+    if(c.literal("true")) v=true;
+    else if(c.literal("false")) v=false;
+    else c.fail("expected a boolean");
+  }
+
+  template<Integer T>
+  inline void read(cursor &c, T &v){
+    auto n=c.number();
+    if(n.type==parser::number::integer && std::in_range<T>(n.i)) v=T(n.i);
+    else if(n.type==parser::number::unsigned_integer && std::in_range<T>(n.u)) v=T(n.u);
+    else c.fail("expected an integer in range");
+  }
+
+  template<std::floating_point T>
+  inline void read(cursor &c, T &v){
+    auto n=c.number();
+    if(n.type==parser::number::integer) v=T(n.i);
+    else if(n.type==parser::number::unsigned_integer) v=T(n.u);
+    else v=T(n.d);
+  }
+
+  inline void read(cursor &c, std::string &v){
+    bool escaped;
+    auto raw=c.string(escaped);
+    if(escaped) v=parser::unescape(raw);
+    else v.assign(raw);
+  }
+
+  // a view into the input, which must outlive it: escaped strings cannot be viewed
+  inline void read(cursor &c, string_view &v){
+    bool escaped;
+    v=c.string(escaped);
+    if(escaped) c.fail("an escaped string cannot be a string_view");
+  }
+
+  // any value, kept as a json
+  inline void read(cursor &c, json &v){
+    v=json(c.skip());
+  }
+
+  template<Optional T>
+  inline void read(cursor &c, T &v){
+    if(c.literal("null")) v.reset();
+    else read(c, v.emplace());
+  }
+
+  template<Sequence T>
+  inline void read(cursor &c, T &v){
+    v.clear();
+    c.expect('[');
+    if(c.consume(']')) return;
+    do read(c, v.emplace_back());
+    while(c.consume(','));
+    c.expect(']');
+  }
+
+  template<Map T>
+  inline void read(cursor &c, T &v){
+    v.clear();
+    c.expect('{');
+    if(c.consume('}')) return;
+    do{
+      bool escaped;
+      auto raw=c.string(escaped);
+      c.expect(':');
+      auto &child=escaped? v[typename T::key_type(parser::unescape(raw))]: v[typename T::key_type(raw)];
+      read(c, child);
+    }while(c.consume(','));
+    c.expect('}');
+  }
+
+  // members missing from the input keep their value, unknown members are skipped
+  template<Bound T>
+  inline void read(cursor &c, T &v){
+    using b=binding<T>;
+    c.expect('{');
+    if(c.consume('}')) return;
+    do{
+      bool escaped;
+      auto raw=c.string(escaped);
+      std::string name;
+      if(escaped) raw=name=parser::unescape(raw);
+      c.expect(':');
+      auto i=b::hash.find(b::names, raw);
+      if(i<b::count) b::readers[i](c, v);
+      else c.skip();
+    }while(c.consume(','));
+    c.expect('}');
+  }
+
+  inline void write(writer &w, bool v){
+    w.boolean(v);
+  }
+
+  template<Integer T>
+  inline void write(writer &w, T v){
+    w.number(v);
+  }
+
+  template<std::floating_point T>
+  inline void write(writer &w, T v){
+    w.number(double(v));
+  }
+
+  template<String T>
+  inline void write(writer &w, const T &v){
+    w.string(v);
+  }
+
+  inline void write(writer &w, const json &v){
+    w.value(v);
+  }
+
+  // an empty optional is written as null
+  template<Optional T>
+  inline void write(writer &w, const T &v){
+    if(v) write(w, *v);
+    else w.null();
+  }
+
+  template<Sequence T>
+  inline void write(writer &w, const T &v){
+    w.start_array();
+    for(auto &child: v) write(w, child);
+    w.end_array();
+  }
+
+  template<Map T>
+  inline void write(writer &w, const T &v){
+    w.start_object();
+    for(auto &[key, child]: v){
+      w.key(key);
+      write(w, child);
+    }
+    w.end_object();
+  }
+
+  template<Bound T>
+  inline void write(writer &w, const T &v){
+    w.start_object();
+    std::apply([&](auto &...m){
+      if constexpr(binding<T>::plain) ((w.raw_key(m.name), write(w, v.*m.ptr)), ...);
+      else ((w.key(m.name), write(w, v.*m.ptr)), ...);
+    }, binding<T>::members);
+    w.end_object();
+  }
+
+  // parse `raw` into v: a bound struct, a vector, a map, an optional, a string, a number or a bool
+  template<typename T>
+  inline void parse(string_view raw, T &v){
+    cursor c(raw.data(), raw.data()+raw.size());
+    read(c, v);
+    if(c.peek()!='\0') c.fail("trailing characters");
+  }
+
+  template<typename T>
+  inline T parse(string_view raw){
+    T v{};
+    parse(raw, v);
+    return v;
+  }
+
+  template<typename T>
+  inline std::string dump(const T &v, size_t indent=0){
+    std::string res;
+    writer w(res, indent);
+    write(w, v);
+    return res;
+  }
+}
+}
+}
+
+// XJSON_BIND(type, member, ...): bind the members of a struct under their own names, at global scope
+#define XJSON_BIND(type, ...) \
+  template<> \
+  struct xihale::json::json_traits<type>{ \
+    using bound_type=type; \
+    static constexpr std::tuple members{XJSON_FOR_EACH(XJSON_BIND_MEMBER, __VA_ARGS__)}; \
+  }
+
+#define XJSON_BIND_MEMBER(name) xihale::json::bind::member(#name, &bound_type::name),
+
+// XJSON_FOR_EACH(macro, a, b, ...) is macro(a) macro(b) ..., up to 256 arguments
+#define XJSON_FOR_EACH(macro, ...) __VA_OPT__(XJSON_EXPAND(XJSON_FOR_EACH_STEP(macro, __VA_ARGS__)))
+#define XJSON_FOR_EACH_STEP(macro, first, ...) macro(first) __VA_OPT__(XJSON_FOR_EACH_AGAIN XJSON_PARENS (macro, __VA_ARGS__))
+#define XJSON_FOR_EACH_AGAIN() XJSON_FOR_EACH_STEP
+#define XJSON_PARENS ()
+#define XJSON_EXPAND(...) XJSON_EXPAND3(XJSON_EXPAND3(XJSON_EXPAND3(XJSON_EXPAND3(__VA_ARGS__))))
+#define XJSON_EXPAND3(...) XJSON_EXPAND2(XJSON_EXPAND2(XJSON_EXPAND2(XJSON_EXPAND2(__VA_ARGS__))))
+#define XJSON_EXPAND2(...) XJSON_EXPAND1(XJSON_EXPAND1(XJSON_EXPAND1(XJSON_EXPAND1(__VA_ARGS__))))
+#define XJSON_EXPAND1(...) __VA_ARGS__
@@ -0,0 +1,141 @@
+// Parse a file straight from a read only mapping of it
+
+#pragma once
+
+#include "json.hpp"
+
+#include <cerrno>
+#include <fstream>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define XJSON_MMAP
+#endif
+
+namespace xihale{
+namespace json{
+
+  // a whole file in memory, followed by at least `padding` readable zero bytes
+  // mapped when the system can and the file is a regular one, read into a buffer otherwise
+  // e.g. for a lazy pass: ondemand::document doc(file.view())
+  class mapped_file{
+  public:
+    static constexpr size_t padding=64;
+
+    explicit mapped_file(const std::string &path){
+#ifdef XJSON_MMAP
+      int fd=::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if(fd<0) fail(path, errno);
+      struct stat st;
+      if(::fstat(fd, &st)<0){
+        int err=errno;
+        ::close(fd);
+        fail(path, err);
+      }
+      // a pipe, a fifo or a file of /proc tells no size to map: read it instead
+      if(!S_ISREG(st.st_mode) || st.st_size==0){
+        int err=read(fd);
+        ::close(fd);
+        if(err) fail(path, err);
+        return;
+      }
+      len=st.st_size;
+      // reserve the file and the padding as zero pages, then put the file over the start of it
+      mapped=len+padding;
+      auto base=::mmap(nullptr, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(base==MAP_FAILED){
+        int err=errno;
+        ::close(fd);
+        fail(path, err);
+      }
+      if(::mmap(base, len, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)==MAP_FAILED){
+        int err=errno;
+        ::munmap(base, mapped);
+        ::close(fd);
+        fail(path, err);
+      }
+      ::close(fd);
+      data=static_cast<const char *>(base);
+      // hints only, read ahead aggressively and use huge pages where the kernel can
+      ::madvise(base, mapped, MADV_SEQUENTIAL);
+      ::madvise(base, mapped, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+      ::madvise(base, mapped, MADV_HUGEPAGE);
+#endif
+#else
+      std::ifstream in(path, std::ios::binary);
+      if(!in) throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), path);
+      buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+      padded();
+#endif
+    }
+
+    mapped_file(const mapped_file &)=delete;
+    mapped_file &operator=(const mapped_file &)=delete;
+
+    ~mapped_file(){
+#ifdef XJSON_MMAP
+      if(mapped) ::munmap(const_cast<char *>(data), mapped);
+#endif
+    }
+
+    std::string_view view() const {
+      return std::string_view(data, len);
+    }
+
+    size_t size() const {
+      return len;
+    }
+
+  private:
+    const char *data=nullptr;
+    size_t len=0;
+    std::string buf{}; // what is read instead of mapped
+#ifdef XJSON_MMAP
+    size_t mapped=0;
+
+    // the whole of fd into the buffer, to its end: 0, or the errno of the read that failed
+    int read(int fd){
+      char chunk[1<<16];
+      for(;;){
+        auto n=::read(fd, chunk, sizeof(chunk));
+        if(n<0 && errno==EINTR) continue;
+        if(n<0) return errno;
+        if(n==0) break;
+        buf.append(chunk, n);
+      }
+      padded();
+      return 0;
+    }
+#endif
+
+    void padded(){
+      len=buf.size();
+      buf.append(padding, '\0');
+      data=buf.data();
+    }
+
+    // err: saved right after the call that failed, closing the file may change errno
+    [[noreturn]] static void fail(const std::string &path, int err){
+      throw std::system_error(err, std::generic_category(), path);
+    }
+  };
+
+  // parse a file without copying it: the strings of the document are views into the mapping,
+  // which lives as long as the document, or its copies
+  inline document parse_file(const std::string &path, std::pmr::memory_resource *arena=nullptr){
+    auto file=std::make_shared<const mapped_file>(path);
+    auto raw=file->view();
+    return document(raw, std::move(file), arena);
+  }
+
+  inline document parse_file(const std::string &path, parser::options opt){
+    auto file=std::make_shared<const mapped_file>(path);
+    auto raw=file->view();
+    return document(raw, std::move(file), opt);
+  }
+}
+}
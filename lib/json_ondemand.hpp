@@ -0,0 +1,347 @@
+// On demand json: navigate the raw bytes, convert a value only when it is read
+
+#pragma once
+
+#include "json.hpp"
+
+#include <cstring>
+#include <iterator>
+
+namespace xihale{
+namespace json{
+namespace ondemand{
+
+  using std::string_view;
+
+  inline const char *skip_blank(const char *p, const char *end){
+    while(p<end && parser::is_blank(*p)) ++p;
+    return p;
+  }
+
+  // p on the opening quote, returns past the closing one
+  inline const char *skip_string(const char *p, const char *end){
+    ++p;
+    while(p<end){
+      auto q=static_cast<const char *>(std::memchr(p, '"', end-p));
+      if(!q) return end;
+      auto b=q;
+      while(b>p && b[-1]=='\\') --b;
+      if((q-b)%2==0) return q+1;
+      p=q+1;
+    }
+    return end;
+  }
+
+  // f(block, classes) over the 64 bytes blocks of [p, end), classified by the stage 1 kernels of the parser,
+  // the last one padded with blanks; f returns false to stop
+  template<parser::block (*classify)(const char *), typename F>
+  inline void blocks_with(const char *p, const char *end, F &f){
+    for(;end-p>=64;p+=64)
+      if(!f(p, classify(p))) return;
+    if(p>=end) return;
+    char tail[64];
+    std::fill(std::begin(tail), std::end(tail), ' ');
+    std::copy(p, end, tail);
+    f(p, classify(tail));
+  }
+
+#ifdef XJSON_X86
+  template<typename F>
+  __attribute__((target("avx2")))
+  inline void blocks_avx2(const char *p, const char *end, F &f){
+    for(;end-p>=64;p+=64)
+      if(!f(p, parser::classify_avx2(p))) return;
+    if(p>=end) return;
+    char tail[64];
+    std::fill(std::begin(tail), std::end(tail), ' ');
+    std::copy(p, end, tail);
+    f(p, parser::classify_avx2(tail));
+  }
+#endif
+
+  template<typename F>
+  inline void blocks(const char *p, const char *end, F &&f){
+#ifdef XJSON_X86
+    static const bool avx2=parser::supported(parser::kernel::avx2);
+    if(avx2) blocks_avx2(p, end, f);
+    else blocks_with<parser::classify_sse2>(p, end, f);
+#else
+    blocks_with<parser::classify_scalar>(p, end, f);
+#endif
+  }
+
+  // p on { or [, returns past the matching close, 64 bytes at a time
+  inline const char *skip_container(const char *p, const char *end){
+    uint64_t escaped_carry=0, in_string_carry=0;
+    int64_t depth=0;
+    auto res=end;
+    blocks(p, end, [&](const char *blk, const parser::block &b){
+      uint64_t quote=b.quote & ~parser::find_escaped(b.backslash, escaped_carry);
+      uint64_t in_string=parser::prefix_xor(quote) ^ in_string_carry;
+      in_string_carry=uint64_t(int64_t(in_string)>>63);
+      uint64_t open=b.open & ~in_string, close=b.close & ~in_string;
+      if(depth>std::popcount(close)){ // cannot reach the matching close in this block
+        depth+=std::popcount(open)-std::popcount(close);
+        return true;
+      }
+      for(auto all=open | close;all;all&=all-1){
+        auto k=std::countr_zero(all);
+        depth+=(open>>k & 1)? 1: -1;
+        if(depth==0){
+          res=blk+k+1;
+          return false;
+        }
+      }
+      return true;
+    });
+    return res;
+  }
+
+  inline const char *skip_scalar(const char *p, const char *end){
+    while(p<end && *p!=',' && *p!='}' && *p!=']' && !parser::is_blank(*p)) ++p;
+    return p;
+  }
+
+  inline const char *skip_value(const char *p, const char *end){
+    if(p==end) return p;
+    if(*p=='"') return skip_string(p, end);
+    if(*p=='{' || *p=='[') return skip_container(p, end);
+    return skip_scalar(p, end);
+  }
+
+  [[noreturn]] inline void invalid(const char *p, const char *end){
+    throw std::invalid_argument("invalid json near `"+std::string(p, std::min<size_t>(end-p, 16))+'`');
+  }
+
+  class iterator;
+
+  // a position in the input, nothing is read before it is asked for
+  class value{
+  public:
+    value(const char *_p, const char *_stop, string_view _key={}): p(skip_blank(_p, _stop)), stop(_stop), k(_key){}
+
+    // the first byte: { [ " t f n, or the start of a number
+    char type() const {
+      return p<stop? *p: '\0';
+    }
+
+    bool is_object() const { return type()=='{'; }
+    bool is_array() const { return type()=='['; }
+    bool is_string() const { return type()=='"'; }
+    bool is_null() const { return type()=='n'; }
+    bool is_bool() const { return type()=='t' || type()=='f'; }
+    bool is_number() const { return type()=='-' || (type()>='0' && type()<='9'); }
+
+    // the member `key` of an object, skipping the members before it without reading them
+    // key is decoded, a name of the input is decoded to compare when it has an escape
+    std::optional<value> find(string_view key) const {
+      if(!is_object()) throw std::bad_variant_access();
+      auto q=skip_blank(p+1, stop);
+      while(q<stop && *q=='"'){
+        auto kend=skip_string(q, stop);
+        auto name=string_view(q+1, kend-q-2);
+        q=skip_blank(kend, stop);
+        if(q==stop || *q!=':') invalid(q, stop);
+        q=skip_blank(q+1, stop);
+        if(name.find('\\')==name.npos? name==key: parser::unescape(name)==key) return value(q, stop, name);
+        q=skip_blank(skip_value(q, stop), stop);
+        if(q<stop && *q==',') q=skip_blank(q+1, stop);
+      }
+      if(q==stop || *q!='}') invalid(q, stop);
+      return std::nullopt;
+    }
+
+    value operator[](string_view key) const {
+      if(auto res=find(key)) return *res;
+      throw std::out_of_range("key not found");
+    }
+
+    value operator[](const char *key) const {
+      return (*this)[string_view(key)];
+    }
+
+    value operator[](const size_t &index) const;
+
+    value operator[](const int &index) const {
+      return (*this)[size_t(index)];
+    }
+
+    iterator begin() const;
+    iterator end() const;
+
+    // the key of this value, when it was reached from an object
+    string_view key() const {
+      return k;
+    }
+
+    // the raw text of the whole value
+    string_view raw_json() const {
+      return string_view(p, skip_value(p, stop)-p);
+    }
+
+    // the raw (still escaped) string
+    string_view get_string_view() const {
+      if(!is_string()) throw std::bad_variant_access();
+      auto raw=raw_json();
+      return raw.substr(1, raw.size()-2);
+    }
+
+    std::string get_string() const {
+      return parser::unescape(get_string_view());
+    }
+
+    long long get_int64() const {
+      auto n=number();
+      if(n.type!=parser::number::integer) throw std::bad_variant_access();
+      return n.i;
+    }
+
+    unsigned long long get_uint64() const {
+      auto n=number();
+      if(n.type==parser::number::unsigned_integer) return n.u;
+      if(n.type!=parser::number::integer || n.i<0) throw std::bad_variant_access();
+      return n.i;
+    }
+
+    double get_double() const {
+      auto n=number();
+      if(n.type==parser::number::integer) return n.i;
+      if(n.type==parser::number::unsigned_integer) return n.u;
+      return n.d;
+    }
+
+    bool get_bool() const {
+      if(!is_bool()) throw std::bad_variant_access();
+      return type()=='t';
+    }
+
+    // materialize this value, and only this one
+    json to_json() const {
+      return json(raw_json());
+    }
+
+  private:
+    friend class iterator;
+
+    const char *p, *stop;
+    string_view k;
+
+    parser::number number() const {
+      if(!is_number()) throw std::bad_variant_access();
+      auto n=parser::parse_number(string_view(p, skip_scalar(p, stop)-p));
+      if(n.type==parser::number::invalid) throw std::bad_variant_access();
+      return n;
+    }
+  };
+
+  // walks the elements of an array, or the members of an object (see value::key)
+  class iterator{
+  public:
+    using iterator_category=std::forward_iterator_tag;
+    using value_type=ondemand::value;
+    using difference_type=std::ptrdiff_t;
+    using pointer=const ondemand::value *;
+    using reference=const ondemand::value &;
+
+    iterator(): cur(nullptr, nullptr), object(false){}
+
+    // p past the opening bracket
+    iterator(const char *p, const char *stop, bool _object): cur(p, stop), object(_object){
+      settle(cur.p);
+    }
+
+    reference operator*() const { return cur; }
+    pointer operator->() const { return &cur; }
+
+    iterator &operator++(){
+      auto q=skip_blank(skip_value(cur.p, cur.stop), cur.stop);
+      if(q<cur.stop && *q==',') ++q;
+      settle(q);
+      return *this;
+    }
+
+    iterator operator++(int){
+      auto res=*this;
+      ++*this;
+      return res;
+    }
+
+    // all the end iterators are equal
+    bool operator==(const iterator &other) const {
+      return cur.p==other.cur.p;
+    }
+
+  private:
+    value cur;
+    bool object;
+
+    // move onto the element (or the member value) at q, or become the end iterator
+    void settle(const char *q){
+      auto stop=cur.stop;
+      q=skip_blank(q, stop);
+      if(q<stop && (*q==']' || *q=='}')){
+        cur=value(nullptr, nullptr);
+        return;
+      }
+      if(q==stop) invalid(q, stop);
+      if(!object){
+        cur=value(q, stop);
+        return;
+      }
+      if(*q!='"') invalid(q, stop);
+      auto kend=skip_string(q, stop);
+      auto name=string_view(q+1, kend-q-2);
+      q=skip_blank(kend, stop);
+      if(q==stop || *q!=':') invalid(q, stop);
+      cur=value(q+1, stop, name);
+    }
+  };
+
+  inline iterator value::begin() const {
+    if(!is_object() && !is_array()) throw std::bad_variant_access();
+    return iterator(p+1, stop, is_object());
+  }
+
+  inline iterator value::end() const {
+    return iterator();
+  }
+
+  inline value value::operator[](const size_t &index) const {
+    if(!is_array()) throw std::bad_variant_access();
+    auto it=begin();
+    for(size_t n=0;n<index && it!=end();++n) ++it;
+    if(it==end()) throw std::out_of_range("index out of range");
+    return *it;
+  }
+
+  // the input must outlive the document and every value taken from it
+  class document{
+  public:
+    explicit document(string_view _raw): raw(_raw){}
+
+    value root() const {
+      return value(raw.data(), raw.data()+raw.size());
+    }
+
+    value operator[](string_view key) const {
+      return root()[key];
+    }
+
+    value operator[](const char *key) const {
+      return root()[key];
+    }
+
+    value operator[](const size_t &index) const {
+      return root()[index];
+    }
+
+    value operator[](const int &index) const {
+      return root()[index];
+    }
+
+  private:
+    string_view raw;
+  };
+}
+}
+}
@@ -0,0 +1,352 @@
+// Parse many json documents at once, on a pool of threads
+
+#pragma once
+
+#include "json.hpp"
+#include "json_ondemand.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+namespace xihale{
+namespace json{
+namespace parallel{
+
+  using std::string_view;
+
+  // a work stealing thread pool: each worker takes the newest task of its own queue,
+  // and steals the oldest task of another queue when its own is empty
+  class pool{
+  public:
+    explicit pool(size_t threads=std::max(1u, std::thread::hardware_concurrency())): queues(threads){
+      for(auto &q: queues) q=std::make_unique<queue>();
+      for(size_t i=0;i<threads;++i) workers.emplace_back([this, i]{ work(i); });
+    }
+
+    pool(const pool &)=delete;
+    pool &operator=(const pool &)=delete;
+
+    // the pending tasks are still run
+    ~pool(){
+      {
+        std::lock_guard lock(m);
+        stop=true;
+      }
+      wake.notify_all();
+      for(auto &t: workers) t.join();
+    }
+
+    size_t size() const {
+      return workers.size();
+    }
+
+    void submit(std::function<void()> task){
+      auto i=owner()==this? self(): next++%queues.size();
+      // counted before it is queued: a worker may take it at once, pending never goes below 0
+      {
+        std::lock_guard lock(m);
+        ++pending;
+      }
+      {
+        std::lock_guard lock(queues[i]->m);
+        queues[i]->tasks.push_back(std::move(task));
+      }
+      wake.notify_one();
+    }
+
+    // run one pending task on the calling thread, false when there is none
+    bool help(){
+      std::function<void()> task;
+      if(!take(owner()==this? self(): queues.size(), task)) return false;
+      task();
+      return true;
+    }
+
+    // run f(0) .. f(n-1) on the pool and wait for them all, the first exception is rethrown
+    template<typename F>
+    void for_each(size_t n, F &&f){
+      size_t left=n;
+      std::exception_ptr error;
+      std::mutex dm;
+      std::condition_variable done;
+      for(size_t i=0;i<n;++i) submit([&, i]{
+        std::exception_ptr e;
+        try{
+          f(i);
+        }catch(...){
+          e=std::current_exception();
+        }
+        // notified under the lock: the waiter may leave as soon as it is released
+        std::lock_guard lock(dm);
+        if(e && !error) error=e;
+        if(--left==0) done.notify_all();
+      });
+      for(;;){
+        {
+          std::lock_guard lock(dm);
+          if(left==0) break;
+        }
+        if(help()) continue;
+        std::unique_lock lock(dm);
+        done.wait(lock, [&]{ return left==0; });
+        break;
+      }
+      if(error) std::rethrow_exception(error);
+    }
+
+  private:
+    struct queue{
+      std::mutex m{};
+      std::deque<std::function<void()>> tasks{};
+    };
+
+    std::vector<std::unique_ptr<queue>> queues;
+    std::vector<std::thread> workers{};
+    std::mutex m{};
+    std::condition_variable wake{};
+    size_t pending=0;
+    bool stop=false;
+    std::atomic<size_t> next{0};
+
+    // the pool and the queue of the calling thread, when it is a worker
+    static const pool *&owner(){
+      thread_local const pool *p=nullptr;
+      return p;
+    }
+
+    static size_t &self(){
+      thread_local size_t i=0;
+      return i;
+    }
+
+    bool take(size_t own, std::function<void()> &task){
+      auto pop=[&](size_t i, bool newest){
+        std::lock_guard lock(queues[i]->m);
+        auto &tasks=queues[i]->tasks;
+        if(tasks.empty()) return false;
+        if(newest) task=std::move(tasks.back()), tasks.pop_back();
+        else task=std::move(tasks.front()), tasks.pop_front();
+        return true;
+      };
+      bool found=own<queues.size() && pop(own, true);
+      for(size_t k=1;!found && k<=queues.size();++k) found=pop((own+k)%queues.size(), false);
+      if(found){
+        std::lock_guard lock(m);
+        --pending;
+      }
+      return found;
+    }
+
+    void work(size_t i){
+      owner()=this;
+      self()=i;
+      for(;;){
+        std::function<void()> task;
+        if(take(i, task)){
+          task();
+          continue;
+        }
+        std::unique_lock lock(m);
+        wake.wait(lock, [&]{ return stop || pending>0; });
+        if(stop && pending==0) return;
+      }
+    }
+  };
+
+  // the documents of a buffer: concatenated, or one per line (ndjson), blanks in between are ignored
+  inline std::vector<string_view> split(string_view raw){
+    std::vector<string_view> docs;
+    auto end=raw.data()+raw.size();
+    for(auto p=ondemand::skip_blank(raw.data(), end);p<end;p=ondemand::skip_blank(p, end)){
+      auto q=ondemand::skip_value(p, end);
+      if(q==p) q=p+1; // a stray delimiter, let the parser of that document complain
+      docs.emplace_back(p, q-p);
+      p=q;
+    }
+    return docs;
+  }
+
+  // parse every document of `raw`, f(json &&) is called on the calling thread, in the order of the input
+  // the documents are parsed `batch` at a time, at most 4 batches per thread are waiting to be delivered
+  template<typename F>
+  requires std::invocable<F, json &&>
+  inline void parse_many(string_view raw, pool &workers, F &&f, size_t batch=64){
+    auto docs=split(raw);
+    size_t batches=(docs.size()+batch-1)/batch;
+    struct slot{
+      std::vector<json> out{};
+      std::exception_ptr error{};
+      bool ready=false;
+    };
+    std::vector<slot> slots(batches);
+    std::mutex m;
+    std::condition_variable done;
+    size_t launched=0;
+
+    auto launch=[&](){
+      auto b=launched++;
+      workers.submit([&, b]{
+        auto &s=slots[b];
+        try{
+          auto last=std::min(docs.size(), (b+1)*batch);
+          s.out.reserve(last-b*batch);
+          for(auto k=b*batch;k<last;++k) s.out.emplace_back(docs[k]);
+        }catch(...){
+          s.error=std::current_exception();
+        }
+        std::lock_guard lock(m);
+        s.ready=true;
+        done.notify_all();
+      });
+    };
+    auto wait=[&](size_t b){
+      for(;;){
+        {
+          std::lock_guard lock(m);
+          if(slots[b].ready) return;
+        }
+        if(workers.help()) continue;
+        std::unique_lock lock(m);
+        done.wait(lock, [&]{ return slots[b].ready; });
+        return;
+      }
+    };
+    // the tasks refer to this frame: they all finish before it is left, even by an exception
+    struct drain{
+      std::function<void()> f;
+      ~drain(){ f(); }
+    } guard{[&]{ for(size_t b=0;b<launched;++b) wait(b); }};
+
+    auto window=std::max<size_t>(1, workers.size()*4);
+    while(launched<std::min(window, batches)) launch();
+    for(size_t b=0;b<batches;++b){
+      wait(b);
+      if(launched<batches) launch();
+      if(slots[b].error) std::rethrow_exception(slots[b].error);
+      for(auto &j: slots[b].out) f(std::move(j));
+      slots[b].out=std::vector<json>();
+    }
+  }
+
+  inline std::vector<json> parse_many(string_view raw, pool &workers, size_t batch=64){
+    std::vector<json> res;
+    parse_many(raw, workers, [&](json &&j){ res.push_back(std::move(j)); }, batch);
+    return res;
+  }
+
+  using ondemand::blocks;
+
+  // what a chunk does to the state, before knowing whether it starts inside a string
+  struct summary{
+    bool odd_quotes;
+    int64_t depth[2]; // change of the bracket depth, if the chunk starts outside / inside a string
+  };
+
+  inline summary summarize(const char *p, const char *end){
+    summary s{false, {0, 0}};
+    uint64_t escaped_carry=0, in_string_carry=0;
+    blocks(p, end, [&](const char *, const parser::block &b){
+      uint64_t quote=b.quote & ~parser::find_escaped(b.backslash, escaped_carry);
+      uint64_t in_string=parser::prefix_xor(quote) ^ in_string_carry;
+      in_string_carry=uint64_t(int64_t(in_string)>>63);
+      s.depth[0]+=std::popcount(b.open & ~in_string)-std::popcount(b.close & ~in_string);
+      s.depth[1]+=std::popcount(b.open & in_string)-std::popcount(b.close & in_string);
+      return true;
+    });
+    s.odd_quotes=in_string_carry;
+    return s;
+  }
+
+  // the commas at depth 1 of a chunk, then the bracket closing depth 1 if it is in the chunk
+  inline void separators(const char *p, const char *end, bool in_string, int64_t depth, std::vector<const char *> &out){
+    uint64_t escaped_carry=0, in_string_carry=in_string? ~uint64_t(0): 0;
+    blocks(p, end, [&](const char *blk, const parser::block &b){
+      uint64_t quote=b.quote & ~parser::find_escaped(b.backslash, escaped_carry);
+      uint64_t in_string=parser::prefix_xor(quote) ^ in_string_carry;
+      in_string_carry=uint64_t(int64_t(in_string)>>63);
+      uint64_t open=b.open & ~in_string, close=b.close & ~in_string, sep=b.op & ~b.open & ~b.close & ~in_string; // , and :
+      if(depth-std::popcount(close)>1){ // depth 1 is not reached in this block
+        depth+=std::popcount(open)-std::popcount(close);
+        return true;
+      }
+      for(auto all=open | close | sep;all;all&=all-1){
+        auto k=std::countr_zero(all);
+        if(open>>k & 1) ++depth;
+        else if(close>>k & 1){
+          if(--depth==0){
+            out.push_back(blk+k);
+            return false;
+          }
+        }else if(depth==1 && blk[k]==',') out.push_back(blk+k);
+      }
+      return true;
+    });
+  }
+
+  // parse a top level array with its elements split across the pool, other documents are parsed as usual
+  // the input is cut in chunks of `chunk` bytes: each chunk is scanned for its quotes and brackets in parallel,
+  // the states at the chunk starts are resolved in order, then the commas at depth 1 are found and
+  // the elements are parsed in parallel, each one right into its place in the array
+  inline json parse_array(string_view raw, pool &workers, size_t chunk=1<<20){
+    auto end=raw.data()+raw.size();
+    auto begin=ondemand::skip_blank(raw.data(), end);
+    if(begin==end || *begin!='[') return json(raw);
+
+    // never cut right after a backslash, so that no escape crosses a cut
+    std::vector<const char *> cuts{begin};
+    for(auto p=begin+std::max<size_t>(chunk, 1);p<end;p+=chunk){
+      while(p<end && p[-1]=='\\') ++p;
+      if(p<end) cuts.push_back(p);
+    }
+    cuts.push_back(end);
+    auto n=cuts.size()-1;
+
+    std::vector<summary> sums(n);
+    workers.for_each(n, [&](size_t i){ sums[i]=summarize(cuts[i], cuts[i+1]); });
+    std::vector<std::pair<bool, int64_t>> starts(n);
+    bool in_string=false;
+    int64_t depth=0;
+    for(size_t i=0;i<n;++i){
+      starts[i]={in_string, depth};
+      depth+=sums[i].depth[in_string];
+      in_string^=sums[i].odd_quotes;
+    }
+
+    std::vector<std::vector<const char *>> seps(n);
+    workers.for_each(n, [&](size_t i){ separators(cuts[i], cuts[i+1], starts[i].first, starts[i].second, seps[i]); });
+
+    // element k is between bounds[k] and bounds[k+1]
+    std::vector<const char *> bounds{begin};
+    for(size_t i=0;i<n && (bounds.size()==1 || *bounds.back()!=']');++i)
+      for(auto q: seps[i]){
+        bounds.push_back(q);
+        if(*q==']') break;
+      }
+    if(bounds.size()==1 || *bounds.back()!=']') bounds.push_back(end); // unterminated
+    auto count=bounds.size()-1;
+    if(count==1 && ondemand::skip_blank(bounds[0]+1, bounds[1])==bounds[1]) count=0;
+
+    json res;
+    res=array_t(count);
+    auto &arr=res.get_array();
+    // groups of elements of about the same size, a few per thread
+    auto per_group=std::max<size_t>(1, (bounds[count]-begin)/(workers.size()*8));
+    std::vector<size_t> groups{0};
+    for(size_t k=0;k<count;++k)
+      if(k+1==count || bounds[k+1]-bounds[groups.back()]>=ptrdiff_t(per_group)) groups.push_back(k+1);
+    workers.for_each(groups.size()-1, [&](size_t g){
+      for(auto k=groups[g];k<groups[g+1];++k){
+        string_view elem(bounds[k]+1, bounds[k+1]-bounds[k]-1);
+        arr[k]=parser::parse(elem);
+      }
+    });
+    return res;
+  }
+}
+}
+}
@@ -0,0 +1,360 @@
+// Immutable json for many threads: versions share their subtrees, a change copies only the path to it
+
+#pragma once
+
+#include "json.hpp"
+
+#include <atomic>
+#include <memory>
+
+namespace xihale{
+namespace json{
+namespace shared{
+
+  using std::string_view;
+
+  class node;
+  using ptr=std::shared_ptr<const node>;
+
+  // a value that never changes once made: any number of threads may read it without locking
+  // the children are held by shared pointers, so a new version of a tree shares all it did not change
+  class node{
+  public:
+    using members=std::vector<std::pair<key, ptr>>; // in insertion order
+    using elements=std::vector<ptr>;
+
+    // a deep conversion: the strings are copied, the keys shared with j
+    static ptr make(const json &j){
+      if(j.is_object()){
+        members m;
+        m.reserve(j.get_const_object().size());
+        for(auto &[k, child]: j.get_const_object()) m.emplace_back(k, make(child));
+        return make(std::move(m));
+      }
+      if(j.is_array()){
+        elements e;
+        e.reserve(j.get_const_array().size());
+        for(auto &child: j.get_const_array()) e.push_back(make(child));
+        return make(std::move(e));
+      }
+      node n;
+      if(j.is_string()) n.val=std::string(j.to_string_view());
+      else if(j.is_unsigned()) n.val=j.operator unsigned long long();
+      else if(j.is_integer()) n.val=j.operator long long();
+      else if(j.is_double()) n.val=j.operator double();
+      else if(j.is_bool()) n.val=j.operator bool();
+      return std::make_shared<const node>(std::move(n));
+    }
+
+    static ptr make(members m){
+      node n;
+      n.val=std::move(m);
+      n.reindex();
+      return std::make_shared<const node>(std::move(n));
+    }
+
+    static ptr make(elements e){
+      node n;
+      n.val=std::move(e);
+      return std::make_shared<const node>(std::move(n));
+    }
+
+    node(node &&)=default;
+    node &operator=(node &&)=default;
+
+    bool is_null() const { return std::holds_alternative<std::nullptr_t>(val); }
+    bool is_object() const { return std::holds_alternative<members>(val); }
+    bool is_array() const { return std::holds_alternative<elements>(val); }
+    bool is_string() const { return std::holds_alternative<std::string>(val); }
+    bool is_bool() const { return std::holds_alternative<bool>(val); }
+    bool is_double() const { return std::holds_alternative<double>(val); }
+    bool is_unsigned() const { return std::holds_alternative<unsigned long long>(val); }
+    bool is_integer() const { return std::holds_alternative<long long>(val) || is_unsigned(); }
+    bool is_number() const { return is_integer() || is_double(); }
+
+    const members &get_members() const { return std::get<members>(val); }
+    const elements &get_elements() const { return std::get<elements>(val); }
+
+    // the members or the elements
+    size_t size() const {
+      return is_object()? get_members().size(): get_elements().size();
+    }
+
+    // the value at a json pointer, nullptr when there is none: the first one for a path with wildcards or slices
+    const node *find(const path &p) const;
+
+    const node &operator[](string_view k) const {
+      auto &m=get_members();
+      auto i=locate(k, slots? std::hash<string_view>{}(k): 0);
+      if(i==m.size()) throw std::out_of_range(std::format("key not found: {}", k));
+      return *m[i].second;
+    }
+
+    const node &operator[](const char *k) const {
+      return (*this)[string_view(k)];
+    }
+
+    const node &operator[](const size_t &index) const {
+      return *get_elements().at(index);
+    }
+
+    const node &operator[](const int &index) const {
+      return *get_elements().at(index);
+    }
+
+    template <typename T>
+    requires std::is_floating_point_v<T>
+    operator T() const {
+      if(auto i=std::get_if<long long>(&val)) return static_cast<T>(*i);
+      if(auto u=std::get_if<unsigned long long>(&val)) return static_cast<T>(*u);
+      return static_cast<T>(std::get<double>(val));
+    }
+
+    template <typename T>
+    requires (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+    operator T() const {
+      if(auto u=std::get_if<unsigned long long>(&val)) return static_cast<T>(*u);
+      return static_cast<T>(std::get<long long>(val));
+    }
+
+    explicit operator bool() const {
+      return std::get<bool>(val);
+    }
+
+    string_view to_string_view() const {
+      return std::get<std::string>(val);
+    }
+
+    // a mutable copy of the whole subtree
+    json to_json() const {
+      json res;
+      std::visit([&](auto &v){
+        using T=std::remove_cvref_t<decltype(v)>;
+        if constexpr(std::is_same_v<T, members>){
+          res=object_t();
+          auto &obj=res.get_object();
+          obj.reserve(v.size());
+          for(auto &[k, child]: v) obj.emplace(k, child->to_json());
+        }else if constexpr(std::is_same_v<T, elements>){
+          res=array_t();
+          auto &arr=res.get_array();
+          arr.reserve(v.size());
+          for(auto &child: v) arr.push_back(child->to_json());
+        }else res=v;
+      }, val);
+      return res;
+    }
+
+    void write(writer &w) const {
+      std::visit([&](auto &v){
+        using T=std::remove_cvref_t<decltype(v)>;
+        if constexpr(std::is_same_v<T, members>){
+          w.start_object();
+          for(auto &[k, child]: v){
+            w.key(k);
+            child->write(w);
+          }
+          w.end_object();
+        }else if constexpr(std::is_same_v<T, elements>){
+          w.start_array();
+          for(auto &child: v) child->write(w);
+          w.end_array();
+        }else if constexpr(std::is_same_v<T, std::string>) w.string(v);
+        else if constexpr(std::is_same_v<T, bool>) w.boolean(v);
+        else if constexpr(std::is_same_v<T, std::nullptr_t>) w.null();
+        else w.number(v);
+      }, val);
+    }
+
+    std::string dump(size_t indent=0) const {
+      std::string res;
+      writer w(res, indent);
+      write(w);
+      return res;
+    }
+
+  private:
+    friend class document;
+
+    static constexpr size_t index_min=16;
+
+    std::variant<std::nullptr_t, bool, long long, unsigned long long, double, std::string, members, elements> val{};
+    // big objects: open addressing over the key hashes, 1 + the position of a member, 0 when empty
+    std::unique_ptr<uint32_t[]> slots{};
+    uint32_t capacity=0;
+
+    node()=default;
+
+    // n with its members replaced by m, which has the same keys in the same order: the index is copied, not rebuilt
+    static ptr remake(const node &n, members m){
+      node res;
+      res.val=std::move(m);
+      if(n.slots){
+        res.capacity=n.capacity;
+        res.slots.reset(new uint32_t[n.capacity]);
+        std::copy_n(n.slots.get(), n.capacity, res.slots.get());
+      }
+      return std::make_shared<const node>(std::move(res));
+    }
+
+    size_t locate(string_view k, size_t hash) const {
+      auto &m=get_members();
+      if(!slots){
+        for(size_t i=0;i<m.size();++i)
+          if(m[i].first.view()==k) return i;
+        return m.size();
+      }
+      for(auto s=hash & (capacity-1);slots[s];s=(s+1) & (capacity-1)){
+        auto &member=m[slots[s]-1].first;
+        if(member.hash()==hash && member.view()==k) return slots[s]-1;
+      }
+      return m.size();
+    }
+
+    void reindex(){
+      auto &m=get_members();
+      if(m.size()<index_min) return;
+      capacity=std::bit_ceil(m.size()*4);
+      slots.reset(new uint32_t[capacity]());
+      for(size_t i=0;i<m.size();++i){
+        auto s=m[i].first.hash() & (capacity-1);
+        while(slots[s]) s=(s+1) & (capacity-1);
+        slots[s]=i+1;
+      }
+    }
+  };
+
+  // one version of a document: copying it copies a pointer, and it never changes
+  // set() and erase() make a new version, copying only the nodes from the root to the change
+  class document{
+  public:
+    document(): root(node::make(json(nullptr))){}
+    explicit document(const json &j): root(node::make(j)){}
+    explicit document(ptr _root): root(std::move(_root)){}
+
+    const node &operator*() const { return *root; }
+    const node *operator->() const { return root.get(); }
+
+    const ptr &get() const {
+      return root;
+    }
+
+    // the value at p replaced by v, or added when p names a missing member, or the element right after the last one
+    // p is a plain json pointer, without wildcards nor slices
+    document set(const path &p, const json &v) const {
+      return document(change(*root, p, 0, node::make(v)));
+    }
+
+    // the member or the element at p removed
+    document erase(const path &p) const {
+      if(p.segments.empty()) throw std::invalid_argument("cannot erase the root");
+      return document(change(*root, p, 0, nullptr));
+    }
+
+    json to_json() const {
+      return root->to_json();
+    }
+
+    std::string dump(size_t indent=0) const {
+      return root->dump(indent);
+    }
+
+  private:
+    ptr root;
+
+    // a copy of n with the value at p[k..] replaced by v, or removed when v is null
+    static ptr change(const node &n, const path &p, size_t k, const ptr &v){
+      if(k==p.segments.size()) return v;
+      auto &s=p.segments[k];
+      if(s.type!=path::segment::member) throw std::invalid_argument("a change needs a plain json pointer");
+      bool last=k+1==p.segments.size();
+      if(n.is_object()){
+        auto m=n.get_members();
+        auto i=n.locate(s.name, s.hash);
+        if(i==m.size()){
+          if(!last || !v) throw std::out_of_range("path not found");
+          m.emplace_back(key(s.name), v);
+        }else if(last && !v) m.erase(m.begin()+i);
+        else{
+          m[i].second=change(*m[i].second, p, k+1, v);
+          return node::remake(n, std::move(m));
+        }
+        return node::make(std::move(m));
+      }
+      if(n.is_array()){
+        auto e=n.get_elements();
+        auto i=s.name=="-"? e.size(): s.index;
+        if(last && v && i==e.size()) e.push_back(v);
+        else if(i>=e.size()) throw std::out_of_range("path not found");
+        else if(last && !v) e.erase(e.begin()+i);
+        else e[i]=change(*e[i], p, k+1, v);
+        return node::make(std::move(e));
+      }
+      throw std::out_of_range("path not found");
+    }
+  };
+
+  inline const node *node::find(const path &p) const {
+    const node *res=nullptr;
+    auto walk=[&](auto &self, const node &n, size_t k)->bool{
+      if(k==p.segments.size()){
+        res=&n;
+        return false;
+      }
+      auto &s=p.segments[k];
+      if(n.is_object()){
+        auto &m=n.get_members();
+        if(s.type==path::segment::wildcard){
+          for(auto &[key, child]: m)
+            if(!self(self, *child, k+1)) return false;
+          return true;
+        }
+        auto i=n.locate(s.name, s.hash);
+        return i==m.size() || self(self, *m[i].second, k+1);
+      }
+      if(n.is_array()){
+        auto &e=n.get_elements();
+        size_t begin=0, end=e.size();
+        if(s.type==path::segment::member) begin=s.index, end=s.index==path::npos? s.index: s.index+1;
+        else if(s.type==path::segment::slice) begin=s.index, end=s.end;
+        for(auto i=begin;i<std::min(end, e.size());++i)
+          if(!self(self, *e[i], k+1)) return false;
+      }
+      return true;
+    };
+    walk(walk, *this, 0);
+    return res;
+  }
+
+  // the latest version, for readers on any thread: load() takes a snapshot that stays valid as long as it is held,
+  // publish() and update() swap in a new one atomically
+  class publisher{
+  public:
+    explicit publisher(document d=document()): current(d.get()){}
+    publisher(const publisher &)=delete;
+    publisher &operator=(const publisher &)=delete;
+
+    document load() const {
+      return document(current.load(std::memory_order_acquire));
+    }
+
+    void publish(const document &d){
+      current.store(d.get(), std::memory_order_release);
+    }
+
+    // publishes f(latest), f is called again when another writer published in between
+    template<typename F>
+    document update(F &&f){
+      auto cur=current.load(std::memory_order_acquire);
+      for(;;){
+        document next=f(document(cur));
+        if(current.compare_exchange_weak(cur, next.get(), std::memory_order_acq_rel, std::memory_order_acquire)) return next;
+      }
+    }
+
+  private:
+    std::atomic<ptr> current;
+  };
+}
+}
+}
@@ -0,0 +1,247 @@
+// Incremental json: feed the input chunk by chunk, get SAX style events
+
+#pragma once
+
+#include "json.hpp"
+
+#include <istream>
+
+namespace xihale{
+namespace json{
+namespace stream{
+
+  using std::string_view;
+
+  // a handler has the members:
+  //   start_object() end_object() start_array() end_array()
+  //   key(string_view) string(string_view) number(long long) number(double) boolean(bool) null()
+  // and optionally number(unsigned long long) for the integers above the range of long long,
+  // without it they come as doubles
+  // strings are handed over raw (still escaped) and only valid during the call
+  template<typename T>
+  concept handler=requires(T h, string_view s){
+    h.start_object(); h.end_object(); h.start_array(); h.end_array();
+    h.key(s); h.string(s); h.number(0ll); h.number(0.0); h.boolean(true); h.null();
+  };
+
+  // a resumable state machine, a token may be cut anywhere between two chunks
+  // memory: one byte per nesting level, plus the token being cut
+  template<handler H>
+  class push_parser{
+  public:
+    explicit push_parser(H &_h, size_t _max_depth=1024): h(_h), max_depth(_max_depth){}
+    push_parser(const push_parser &)=delete;
+    push_parser &operator=(const push_parser &)=delete;
+
+    void feed(string_view chunk){
+      size_t i=0, n=chunk.size();
+      mark=0;
+      while(i<n){
+        char ch=chunk[i];
+        switch(st){
+          case state::string: {
+            auto j=i;
+            for(;j<n;++j){
+              if(escaped) escaped=false;
+              else if(chunk[j]=='\\') escaped=true;
+              else if(chunk[j]=='"') break;
+            }
+            if(j==n){
+              i=n;
+              break;
+            }
+            auto str=token_until(chunk, j);
+            if(is_key) h.key(str), st=state::colon;
+            else h.string(str), value_done();
+            token.clear();
+            i=j+1;
+            break;
+          }
+          case state::number:
+            if((ch>='0' && ch<='9') || ch=='-' || ch=='+' || ch=='.' || ch=='e' || ch=='E'){
+              ++i;
+              break;
+            }
+            number(token_until(chunk, i));
+            break; // ch is read again after the number
+          case state::literal:
+            if(ch!=literal[matched]) fail(chunk, i);
+            ++i;
+            if(literal[++matched]=='\0'){
+              if(literal[0]=='t') h.boolean(true);
+              else if(literal[0]=='f') h.boolean(false);
+              else h.null();
+              value_done();
+            }
+            break;
+          default:
+            if(parser::is_blank(ch)){
+              ++i;
+              break;
+            }
+            structural(chunk, i);
+            ++i;
+        }
+      }
+      // keep the part of the token in this chunk
+      if(st==state::string || st==state::number) token.append(chunk.substr(mark));
+      offset+=n;
+    }
+
+    // the end of the input
+    void finish(){
+      if(st==state::number){
+        std::string num;
+        num.swap(token);
+        number(num);
+      }
+      if(st!=state::done) throw std::invalid_argument(std::format("invalid json: unexpected end at byte {}", offset));
+    }
+
+    bool done() const {
+      return st==state::done;
+    }
+
+  private:
+    enum class state: uint8_t{
+      value, first_value, key, first_key, colon, after_value, string, number, literal, done
+    };
+
+    H &h;
+    size_t max_depth;
+    state st=state::value;
+    std::string stack{}; // { or [ for each open container
+    std::string token{}; // a string or a number started in an earlier chunk
+    size_t mark=0; // where the current token starts in the chunk
+    size_t offset=0; // bytes of the previous chunks
+    bool is_key=false, escaped=false;
+    const char *literal=nullptr;
+    size_t matched=0;
+
+    [[noreturn]] void fail(string_view chunk, size_t i){
+      throw std::invalid_argument(std::format("invalid json: unexpected `{}` at byte {}", chunk[i], offset+i));
+    }
+
+    // the token from `mark` to `i`, a view on the chunk when it was not cut
+    string_view token_until(string_view chunk, size_t i){
+      if(token.empty()) return chunk.substr(mark, i-mark);
+      token.append(chunk.substr(mark, i-mark));
+      return token;
+    }
+
+    void value_done(){
+      st=stack.empty()? state::done: state::after_value;
+    }
+
+    void number(string_view str){
+      auto n=parser::parse_number(str);
+      if(n.type==parser::number::invalid) throw std::invalid_argument(std::format("invalid json: bad number `{}`", str));
+      if(n.type==parser::number::integer) h.number(n.i);
+      else if(n.type!=parser::number::unsigned_integer) h.number(n.d);
+      else if constexpr(requires{ h.number(n.u); }) h.number(n.u);
+      else h.number(double(n.u));
+      token.clear();
+      value_done();
+    }
+
+    void open(char type){
+      if(stack.size()>=max_depth) throw std::invalid_argument(std::format("invalid json: nesting deeper than {}", max_depth));
+      stack.push_back(type);
+      if(type=='{') h.start_object(), st=state::first_key;
+      else h.start_array(), st=state::first_value;
+    }
+
+    void close(string_view chunk, size_t i){
+      if(stack.empty() || stack.back()!=(chunk[i]=='}'? '{': '[')) fail(chunk, i);
+      stack.pop_back();
+      if(chunk[i]=='}') h.end_object();
+      else h.end_array();
+      value_done();
+    }
+
+    void structural(string_view chunk, size_t i){
+      char ch=chunk[i];
+      switch(st){
+        case state::first_value:
+          if(ch==']') return close(chunk, i);
+          [[fallthrough]];
+        case state::value:
+          if(ch=='{' || ch=='[') return open(ch);
+          if(ch=='"'){
+            st=state::string, is_key=false, mark=i+1;
+            return;
+          }
+          if(ch=='-' || (ch>='0' && ch<='9')){
+            st=state::number, mark=i;
+            return;
+          }
+          if(ch=='t') literal="true";
+          else if(ch=='f') literal="false";
+          else if(ch=='n') literal="null";
+          else fail(chunk, i);
+          st=state::literal, matched=1;
+          return;
+        case state::first_key:
+          if(ch=='}') return close(chunk, i);
+          [[fallthrough]];
+        case state::key:
+          if(ch!='"') fail(chunk, i);
+          st=state::string, is_key=true, mark=i+1;
+          return;
+        case state::colon:
+          if(ch!=':') fail(chunk, i);
+          st=state::value;
+          return;
+        case state::after_value:
+          if(ch==',') st=stack.back()=='{'? state::key: state::value;
+          else if(ch=='}' || ch==']') close(chunk, i);
+          else fail(chunk, i);
+          return;
+        default: // done: only blanks may follow
+          fail(chunk, i);
+      }
+    }
+  };
+
+  // builds a json from the events, in place, the strings decoded like the parser does
+  class builder{
+  public:
+    void start_object(){ b.begin_object(); }
+    void start_array(){ b.begin_array(); }
+    void end_object(){ b.end_object(); }
+    void end_array(){ b.end_array(); }
+    void key(string_view k){
+      if(k.find('\\')==string_view::npos) b.key(k);
+      else b.key(parser::unescape(k));
+    }
+    void string(string_view s){ b.value(parser::unescape(s)); }
+    void number(long long i){ b.value(i); }
+    void number(unsigned long long u){ b.value(u); }
+    void number(double d){ b.value(d); }
+    void boolean(bool v){ b.value(v); }
+    void null(){ b.value(nullptr); }
+
+    // the document, once the parser is done
+    json &result(){
+      return b.result();
+    }
+
+  private:
+    xihale::json::builder b{};
+  };
+
+  // read a whole document from a stream, chunk by chunk
+  inline json parse(std::istream &in, size_t chunk=1<<16){
+    builder b;
+    push_parser p(b);
+    std::string buf(chunk, '\0');
+    while(in){
+      in.read(buf.data(), buf.size());
+      p.feed(string_view(buf.data(), in.gcount()));
+    }
+    p.finish();
+    return std::move(b.result());
+  }
+}
+}
+}
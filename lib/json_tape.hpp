@@ -0,0 +1,430 @@
+// An immutable json laid out on one tape of tagged 64 bits words
+
+#pragma once
+
+#include "json.hpp"
+
+#include <cstring>
+#include <iterator>
+
+namespace xihale{
+namespace json{
+
+  // every value starts with one word: its type in the high byte, a payload in the low 56 bits
+  //   { [    index after the matching close word, and the element count in bits 32..55
+  //   } ]    index of the matching open word
+  //   "      offset of the string in the string buffer (a 32 bits length then the raw bytes, escapes and all)
+  //   l u d  long long / unsigned long long (above the range of long long) / double, stored in the next word
+  //   t f n  no payload
+  // object members are a string word for the key followed by the value
+  class tape{
+  public:
+    class value;
+    class iterator;
+
+    tape()=default;
+
+    // containers nested deeper than max_depth throw std::invalid_argument, as with parser::options
+    explicit tape(std::string_view raw, size_t max_depth=1024){
+      auto idx=parser::build_index(raw);
+      words.reserve(idx.size+1);
+      read(raw, idx.pos.get(), idx.pos.get()+idx.size, max_depth);
+    }
+
+    explicit tape(const std::string &raw, size_t max_depth=1024): tape(std::string_view(raw), max_depth){}
+    explicit tape(const char *raw, size_t max_depth=1024): tape(std::string_view(raw), max_depth){}
+
+    explicit tape(const json &j, size_t max_depth=1024){
+      write(j, max_depth);
+    }
+
+    value root() const;
+
+    // bytes used by the tape and the strings
+    size_t memory() const {
+      return words.size()*sizeof(uint64_t)+strings.size();
+    }
+
+  private:
+    using ll=long long;
+    using ull=unsigned long long;
+
+    static constexpr uint64_t payload_mask=(uint64_t(1)<<56)-1;
+    static constexpr uint64_t count_max=(1<<24)-1;
+
+    std::vector<uint64_t> words{};
+    std::string strings{};
+    std::string scratch{}; // a decoded string of a json, escaped again
+
+    static uint64_t word(char type, uint64_t payload=0){
+      return uint64_t(uint8_t(type))<<56 | payload;
+    }
+
+    void push_string(std::string_view str){
+      words.push_back(word('"', strings.size()));
+      uint32_t len=str.size();
+      strings.append(reinterpret_cast<const char *>(&len), sizeof(len));
+      strings.append(str);
+    }
+
+    // a decoded string, from a json: stored escaped, like the strings read from text
+    void push_decoded(std::string_view str){
+      if(std::none_of(str.begin(), str.end(), [](char c){ return c=='"' || c=='\\' || uint8_t(c)<0x20; }))
+        return push_string(str);
+      scratch.clear();
+      writer(scratch).string(str);
+      push_string(std::string_view(scratch).substr(1, scratch.size()-2));
+    }
+
+    template<typename T>
+    void push_number(char type, T num){
+      words.push_back(word(type));
+      uint64_t bits;
+      std::memcpy(&bits, &num, sizeof(bits));
+      words.push_back(bits);
+    }
+
+    // patch the open word at `open` once its members are written
+    void close(size_t open, char type, uint64_t count){
+      words.push_back(word(type, open));
+      words[open]|=words.size() | std::min(count, count_max)<<32;
+    }
+
+    // the reader's loop: containers on an explicit stack, stray delimiters read the lenient way
+    void read(std::string_view raw, const uint32_t *it, const uint32_t *end, size_t max_depth){
+      auto peek=[&](){ return it<end? raw[*it]: '\0'; };
+      auto str=[&](){
+        auto bpos=*it+1;
+        ++it;
+        auto epos=it<end? *it: raw.size();
+        if(it<end) ++it;
+        return raw.substr(bpos, epos-bpos);
+      };
+      // a container being read: its open word, and the values in it so far
+      struct frame{
+        size_t open;
+        uint64_t count;
+        bool object;
+      };
+      std::vector<frame> frames;
+      // whether the innermost container has another member: its key is pushed here
+      auto next=[&](){
+        if(frames.back().object){
+          if(peek()!='"') return false;
+          push_string(str());
+          if(peek()==':') ++it;
+          return true;
+        }
+        return it<end && peek()!=']' && peek()!='}';
+      };
+      auto pop=[&](){
+        auto f=frames.back();
+        frames.pop_back();
+        if(it<end) ++it; // } or ]
+        close(f.open, f.object? '}': ']', f.count);
+      };
+      for(;;){
+        auto begin=peek();
+        if(begin=='{' || begin=='['){
+          if(frames.size()>=max_depth)
+            throw std::invalid_argument(std::format("invalid json: nesting too deep at byte {}", *it));
+          frames.push_back({words.size(), 0, begin=='{'});
+          words.push_back(word(begin));
+          ++it;
+          if(next()) continue;
+          pop();
+        }else if(begin=='"') push_string(str());
+        else if(it<end && begin!='}' && begin!=']' && begin!=',' && begin!=':'){
+          auto bpos=*it;
+          ++it;
+          auto epos=it<end? *it: raw.size();
+          while(epos>bpos && parser::is_blank(raw[epos-1])) --epos;
+          auto token=raw.substr(bpos, epos-bpos);
+          if(begin=='t') words.push_back(word('t'));
+          else if(begin=='f') words.push_back(word('f'));
+          else if(begin=='n') words.push_back(word('n'));
+          else{
+            auto n=parser::parse_number(token);
+            if(n.type==parser::number::integer) push_number('l', n.i);
+            else if(n.type==parser::number::unsigned_integer) push_number('u', n.u);
+            else if(n.type==parser::number::real) push_number('d', n.d);
+            else push_string(token); // regarded as String
+          }
+        }else words.push_back(word('n')); // a missing value
+        // a complete value: close the containers that end right after it
+        for(;;){
+          if(frames.empty()) return;
+          ++frames.back().count;
+          auto sep=peek();
+          if(sep==',' || (sep==':' && !frames.back().object)) ++it;
+          if(next()) break;
+          pop();
+        }
+      }
+    }
+
+    void write(const json &j, size_t depth){
+      if((j.is_object() || j.is_array()) && depth==0)
+        throw std::invalid_argument("json nested too deep for a tape");
+      if(j.is_object()){
+        auto open=words.size();
+        words.push_back(word('{'));
+        for(auto &[key, child]: j.get_const_object()){
+          push_decoded(key);
+          write(child, depth-1);
+        }
+        close(open, '}', j.get_const_object().size());
+      }else if(j.is_array()){
+        auto open=words.size();
+        words.push_back(word('['));
+        for(auto &child: j.get_const_array()) write(child, depth-1);
+        close(open, ']', j.get_const_array().size());
+      }else if(j.is_string()) push_decoded(j.to_string_view());
+      else if(j.is_unsigned()) push_number('u', j.getc<ull>());
+      else if(j.is_integer()) push_number('l', j.getc<ll>());
+      else if(j.is_double()) push_number('d', j.getc<double>());
+      else if(j.is_bool()) words.push_back(word(j.getc<bool>()? 't': 'f'));
+      else words.push_back(word('n'));
+    }
+  };
+
+  // a lightweight handle on a tape value, valid as long as the tape
+  class tape::value{
+  public:
+    value(const tape *_t, size_t _i): t(_t), i(_i){}
+
+    char type() const {
+      return t->words[i]>>56;
+    }
+
+    bool is_null() const { return type()=='n'; }
+    bool is_object() const { return type()=='{'; }
+    bool is_array() const { return type()=='['; }
+    bool is_string() const { return type()=='"'; }
+    bool is_integer() const { return type()=='l' || type()=='u'; }
+    bool is_double() const { return type()=='d'; }
+    bool is_number() const { return is_integer() || is_double(); }
+    bool is_bool() const { return type()=='t' || type()=='f'; }
+
+    // members of an object or elements of an array
+    size_t size() const {
+      if(!is_object() && !is_array()) throw std::bad_variant_access();
+      auto count=(payload()>>32) & count_max;
+      if(count<count_max) return count;
+      size_t n=0;
+      for(auto k=first();k!=last();k=after(k)) ++n;
+      return n;
+    }
+
+    value operator[](std::string_view key) const {
+      if(auto res=find(key)) return *res;
+      throw std::out_of_range("key not found");
+    }
+
+    value operator[](const char *key) const {
+      return (*this)[std::string_view(key)];
+    }
+
+    value operator[](const size_t &index) const {
+      if(!is_array()) throw std::bad_variant_access();
+      auto k=first();
+      for(size_t n=0;n<index && k!=last();++n) k=after(k);
+      if(k==last()) throw std::out_of_range("index out of range");
+      return value(t, k);
+    }
+
+    value operator[](const int &index) const {
+      return (*this)[size_t(index)];
+    }
+
+    // key is decoded, the keys on the tape are decoded to compare only when they have an escape
+    std::optional<value> find(std::string_view key) const {
+      if(!is_object()) throw std::bad_variant_access();
+      for(auto k=i+1;k<close();k=next(k+1)){
+        auto raw=value(t, k).to_string_view();
+        if(raw==key || (raw.find('\\')!=raw.npos && parser::unescape(raw)==key)) return value(t, k+1);
+      }
+      return std::nullopt;
+    }
+
+    iterator begin() const;
+    iterator end() const;
+
+    // the key of an object member, when iterating over an object: raw, with its escapes
+    std::string_view key() const {
+      return value(t, i-1).to_string_view();
+    }
+
+    // raw, with its escapes: to_string() decodes them
+    std::string_view to_string_view() const {
+      if(!is_string()) throw std::bad_variant_access();
+      uint32_t len;
+      std::memcpy(&len, t->strings.data()+payload(), sizeof(len));
+      return std::string_view(t->strings.data()+payload()+sizeof(len), len);
+    }
+
+    std::string to_string() const {
+      if(is_string()) return parser::unescape(to_string_view());
+      std::string res;
+      writer w(res);
+      dump(w);
+      return res;
+    }
+
+    template <typename T>
+    requires std::is_floating_point_v<T>
+    operator T() const {
+      if(!is_double()) throw std::bad_variant_access();
+      return static_cast<T>(number<double>());
+    }
+
+    template <typename T>
+    requires std::is_integral_v<T> && (!std::is_same_v<T, bool>)
+    operator T() const {
+      if(!is_integer()) throw std::bad_variant_access();
+      if(type()=='u') return static_cast<T>(number<ull>());
+      return static_cast<T>(number<ll>());
+    }
+
+    operator bool() const {
+      if(!is_bool()) throw std::bad_variant_access();
+      return type()=='t';
+    }
+
+    json to_json() const {
+      json j;
+      switch(type()){
+        case '{':
+          j=object_t();
+          j.get_object().reserve(size());
+          for(auto k=first();k!=last();k=after(k)) j.get_object().emplace(parser::unescape(value(t, k).key()), value(t, k).to_json());
+          break;
+        case '[':
+          j=array_t();
+          j.get_array().reserve(size());
+          for(auto k=first();k!=last();k=after(k)) j.get_array().push_back(value(t, k).to_json());
+          break;
+        case '"': j=parser::unescape(to_string_view()); break;
+        case 'l': j=number<ll>(); break;
+        case 'u': j=number<ull>(); break;
+        case 'd': j=number<double>(); break;
+        case 't': j=true; break;
+        case 'f': j=false; break;
+        default: j=nullptr;
+      }
+      return j;
+    }
+
+  private:
+    friend class tape::iterator;
+
+    const tape *t;
+    size_t i;
+
+    uint64_t payload() const {
+      return t->words[i] & payload_mask;
+    }
+
+    // index of the close word of a container
+    size_t close() const {
+      return (payload() & 0xffffffff)-1;
+    }
+
+    // first, one past the last, and next element of a container, member values for an object
+    size_t first() const {
+      return i+1+is_object();
+    }
+
+    size_t last() const {
+      return close()+is_object();
+    }
+
+    size_t after(size_t k) const {
+      return next(k)+is_object();
+    }
+
+    // index of the value after the one at `k`
+    size_t next(size_t k) const {
+      auto type=char(t->words[k]>>56);
+      if(type=='{' || type=='[') return t->words[k] & 0xffffffff;
+      if(type=='l' || type=='u' || type=='d') return k+2;
+      return k+1;
+    }
+
+    template<typename T>
+    T number() const {
+      T res;
+      std::memcpy(&res, &t->words[i+1], sizeof(res));
+      return res;
+    }
+
+    void dump(writer &w) const {
+      switch(type()){
+        case '{': case '[':
+          is_object()? w.start_object(): w.start_array();
+          for(auto k=first();k!=last();k=after(k)){
+            if(is_object()) w.raw_key(value(t, k).key());
+            value(t, k).dump(w);
+          }
+          is_object()? w.end_object(): w.end_array();
+          break;
+        case '"': w.raw_string(to_string_view()); break;
+        case 'l': w.number(number<ll>()); break;
+        case 'u': w.number(number<ull>()); break;
+        case 'd': w.number(number<double>()); break;
+        case 't': w.boolean(true); break;
+        case 'f': w.boolean(false); break;
+        default: w.null();
+      }
+    }
+  };
+
+  // walks the elements of an array, or the member values of an object (see value::key)
+  class tape::iterator{
+  public:
+    using iterator_category=std::forward_iterator_tag;
+    using value_type=tape::value;
+    using difference_type=std::ptrdiff_t;
+    using pointer=const tape::value *;
+    using reference=const tape::value &;
+
+    iterator(): cur(nullptr, 0), step(0){}
+    iterator(const tape::value &container, size_t i): cur(container.t, i), step(container.is_object()){}
+
+    reference operator*() const { return cur; }
+    pointer operator->() const { return &cur; }
+
+    iterator &operator++(){
+      cur.i=cur.next(cur.i)+step;
+      return *this;
+    }
+
+    iterator operator++(int){
+      auto res=*this;
+      ++*this;
+      return res;
+    }
+
+    bool operator==(const iterator &other) const {
+      return cur.i==other.cur.i;
+    }
+
+  private:
+    tape::value cur;
+    size_t step; // 1 over object members, to skip the key word
+  };
+
+  inline tape::value tape::root() const {
+    return value(this, 0);
+  }
+
+  inline tape::iterator tape::value::begin() const {
+    if(!is_object() && !is_array()) throw std::bad_variant_access();
+    return iterator(*this, first());
+  }
+
+  inline tape::iterator tape::value::end() const {
+    return iterator(*this, last());
+  }
+}
+}
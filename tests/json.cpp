@@ -4,6 +4,8 @@
 #include <string>
 #include <source_location>
 #include <iostream>
+#include <optional>
+#include <sstream>
 #include <assert.h>
 #include <string_view>
 
@@ -83,6 +85,416 @@ int main()try{
   auto j8=gen_j8();
   assert_equal(j8["a"].to_string(), "val");
 
+  document d(std::string(R"({"a": ["x\ty", "plain"], "b": {"c": "Bad Apple!!"}})"));
+  assert(d.is_object());
+  assert(d["a"][1].is_string());
+  assert_equal(d["a"][0].to_string(), "x\ty");
+  assert_equal(d["a"][1].to_string_view(), std::string_view("plain"));
+  assert_equal(d["b"]["c"].to_string(), "Bad Apple!!");
+  assert_equal(d["a"].to_string(), R"(["x\ty","plain"])");
+
+  std::pmr::monotonic_buffer_resource arena;
+  for(int round=0;round<2;++round){ // an arena is reusable once released
+    {
+      document ad(std::string(R"({"a": [1, "two", {"three": 3}]})"), &arena);
+      assert_equal(ad["a"][1].to_string(), "two");
+      assert_equal(ad["a"][2]["three"].operator int(), 3);
+      assert(ad["a"].get_const_array().get_allocator().resource()==&arena);
+      document copy=ad;
+      assert(copy["a"].get_const_array().get_allocator().resource()!=&arena);
+    }
+    arena.release();
+  }
+  // the root of an arena document is in the arena too, and a copy owns all of its strings
+  {
+    struct counting: std::pmr::memory_resource{
+      long live=0;
+      void *do_allocate(size_t n, size_t align) override { ++live; return std::pmr::new_delete_resource()->allocate(n, align); }
+      void do_deallocate(void *p, size_t n, size_t align) override { --live; std::pmr::new_delete_resource()->deallocate(p, n, align); }
+      bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this==&other; }
+    } heap;
+    auto prev=std::pmr::set_default_resource(&heap);
+    alignas(64) char buf[4096];
+    std::optional<document> copy;
+    {
+      std::pmr::monotonic_buffer_resource local(buf, sizeof(buf), std::pmr::null_memory_resource());
+      for(int i=0;i<3;++i){
+        document ad(std::string(R"({"k": "a\tb", "n": [1, "two"]})"), &local);
+        assert(ad.get_const_object().begin()->second.is_string());
+        copy=ad;
+        document moved=std::move(ad);
+        moved=document(std::string(R"({"other": {}})"), &local);
+      }
+    }
+    std::fill(std::begin(buf), std::end(buf), 'x');
+    assert_equal(copy->dump(), R"({"k":"a\tb","n":[1,"two"]})");
+    copy.reset();
+    // a change puts values from the heap in the tree, the document frees them when it goes
+    {
+      std::pmr::monotonic_buffer_resource grown(std::pmr::new_delete_resource());
+      document ad(std::string(R"({"n": [1], "o": {}})"), &grown);
+      json extra=array_t();
+      extra.emplace_back("a long string, past the inline buffer");
+      ad["n"].push_back(std::move(extra));
+      ad["o"].insert("c", json(array_t(3)));
+      ad.emplace("s", std::string(100, 'y'));
+      assert(heap.live>0);
+      assert_equal(ad["n"][1][0].to_string_view().size(), 37u);
+    }
+    std::pmr::set_default_resource(prev);
+    assert_equal(heap.live, 0l);
+  }
+  std::string_view araw=R"(["x", ["y"]])";
+  json aj=parser::parse(araw, {.resource=&arena});
+  assert_equal(aj[1][0].to_string(), "y");
+
+  // offsets past 4 GiB do not fit the index: such an input is rejected before it is read
+  {
+    bool thrown=false;
+    try{
+      parser::build_index(std::string_view(araw.data(), size_t(UINT32_MAX)+1));
+    }catch(std::length_error &){
+      thrown=true;
+    }
+    assert(thrown);
+  }
+
+  // the simd kernels must find the same structural positions as the scalar one
+  auto same_index=[](std::string_view raw){
+    auto ref=parser::build_index(raw, parser::kernel::scalar);
+    for(auto k: {parser::kernel::sse2, parser::kernel::avx2}){
+      if(!parser::supported(k)) continue;
+      auto idx=parser::build_index(raw, k);
+      assert(idx.size==ref.size);
+      assert(std::equal(idx.pos.get(), idx.pos.get()+idx.size, ref.pos.get()));
+    }
+  };
+  std::string escapes(61, ' ');
+  escapes+=R"(["\\\"", "\\", "a\"b", {"k": -1.5e3}, true, null])";
+  same_index(escapes);
+  same_index(j7.to_string());
+
+  // one value is read at a time: concatenated documents are indexed a value at a time, not the whole tail each call
+  {
+    std::string many;
+    for(int i=0;i<2000;++i) many+=std::format("{{\"id\": {}, \"tags\": [\"a\", \"b}}]\"]}} {} \"s{}\" ", i, i, i);
+    auto idx=parser::build_index(many, parser::kernel::automatic, true);
+    assert_equal(idx.bytes, 64u); // the block with the end of the first object and the position after it
+    std::string_view rest=many;
+    for(int i=0;i<2000;++i){
+      assert_equal(parser::parse(rest)["id"].operator int(), i);
+      assert_equal(parser::parse(rest).operator int(), i);
+      assert_equal(parser::parse(rest).to_string(), std::format("s{}", i));
+    }
+    assert(rest.empty());
+    // read the lenient way, a value may end before its brackets tell
+    std::string lenient=std::string(R"({"a": 1,, "b": [2}])")+std::string(5000, ' ')+"[3]";
+    std::string_view lr=lenient;
+    assert_equal(parser::parse(lr).dump(), R"({"a":1})");
+    assert_equal(parser::parse(lr).dump(), "\"b\"");
+  }
+
+  json j9(R"({"say": "\"hi\", she said", "n": 1})");
+  assert_equal(j9["n"].operator int(), 1);
+  assert_equal(j9["say"].to_string(), "\"hi\", she said");
+
+  // one buffer for the whole tree, strings of a json are written as they are stored
+  assert_equal(json(R"({"a": [1, {"b": null}, []], "c": {}})")["a"].dump(2), "[\n  1,\n  {\n    \"b\": null\n  },\n  []\n]");
+  assert_equal(j9.dump().size(), j9.operator std::string().size());
+  std::string written;
+  writer(written).start_object().key("k\"\n").string(std::string("tab\there\x01 and a long enough tail \\")).key("n").number(2ll).end_object();
+  assert_equal(written, R"({"k\"\n":"tab\there\u0001 and a long enough tail \\","n":2})");
+  assert_equal(json(written)["n"].operator int(), 2);
+  written.clear();
+  writer(written).string("a \"quoted\"\tline\n");
+  assert_equal(json(written).to_string(), "a \"quoted\"\tline\n");
+  std::ostringstream os;
+  {
+    writer w(os);
+    for(int i=0;i<20;++i) w.value(j7);
+  }
+  assert_equal(os.str().size(), 20*j7.dump().size());
+  auto file=std::tmpfile();
+  {
+    writer(file).value(j4);
+    std::fflush(file);
+    writer w(writer::descriptor{fileno(file)}, 1);
+    w.start_array().boolean(true).end_array();
+  }
+  std::fflush(file);
+  std::rewind(file);
+  char back[64]{};
+  std::fread(back, 1, sizeof(back)-1, file);
+  assert_equal(std::string(back), R"({"a":{"b":[1,2,3]}})" "[\n true\n]");
+  std::fclose(file);
+
+  // integers are exact, a fraction or an exponent makes a double, doubles print back the same
+  assert_equal(j7["result"]["songs"][2]["mark"].operator long long(), 9007199255011456ll);
+  assert_equal(j7["result"]["songs"][3]["album"]["copyrightId"].operator int(), -1);
+  json nums(R"([-42, 1.0000001, -3.5e2, 18446744073709551615, -9223372036854775808, 123456789012345678, 1e400x, 0.1, 3.0, 1e300])");
+  assert(nums[0].is_integer());
+  assert_equal(nums[0].operator int(), -42);
+  assert(nums[1].is_double());
+  assert_equal(nums[2].operator double(), -350.0);
+  assert(nums[3].is_unsigned());
+  assert_equal(nums[3].operator unsigned long long(), 18446744073709551615ull);
+  assert_equal(nums[4].operator long long(), LLONG_MIN);
+  assert_equal(nums[5].operator long long(), 123456789012345678ll);
+  assert(nums[6].is_string());
+  assert_equal(nums.dump(), R"([-42,1.0000001,-350.0,18446744073709551615,-9223372036854775808,123456789012345678,"1e400x",0.1,3.0,1e+300])");
+  assert_equal(json(nums.dump()).dump(), nums.dump());
+  assert_equal(json(std::string("[18446744073709551616]"))[0].operator double(), 18446744073709551616.0);
+  // past the range of a double: still a double, infinite or zero, strict or not
+  for(auto strict: {false, true}){
+    std::string_view raw="[1e400, -1e400, 1e-400, -0.0000000000000000000000000000000000001e-300, 123456789e301]";
+    auto huge=parser::parse(raw, {.strict=strict});
+    for(size_t i=0;i<5;++i) assert(huge[i].is_double());
+    assert_equal(huge[0].operator double(), HUGE_VAL);
+    assert_equal(huge[1].operator double(), -HUGE_VAL);
+    assert_equal(huge[2].operator double(), 0.0);
+    assert(huge[3].operator double()==0.0 && std::signbit(huge[3].operator double()));
+    assert_equal(huge[4].operator double(), HUGE_VAL);
+  }
+
+  // compiled paths: hashed once, no exception when missing, many values in one traversal
+  path name("/result/songs/3/name");
+  assert_equal(j7.at(name).to_string(), "Bad Apple!!");
+  assert_equal(j7.find("/result/songs/3/artists/0/name")->to_string(), "上海アリス幻樂団");
+  assert(j7.find("/result/songs/99/name")==nullptr);
+  assert(j7.find("/result/nothing")==nullptr);
+  assert(j7.find("/result/songCount/x")==nullptr);
+  assert(&j7.at("")==&j7);
+  try{
+    j7.at("/result/nothing");
+    assert(false);
+  }catch(std::out_of_range &){}
+  assert_equal(j7.select("/result/songs/*/name").size(), 10u);
+  auto ids=j7.select("/result/songs/1:3/id");
+  assert_equal(ids.size(), 2u);
+  assert_equal(ids[1]->operator int(), 687506);
+  assert_equal(j7.select("/result/songs/8:/id").size(), 2u);
+  assert_equal(j7.select("/result/songs/*/artists/*/id").size(), 11u);
+  json odd(R"({"a/b": {"m~n": 1}, "*": 2, "1:2": 3})");
+  assert_equal(odd.at("/a~1b/m~0n").operator int(), 1);
+  assert_equal(odd.select("/*").size(), 3u);
+  assert_equal(odd.at("/1:2").operator int(), 3);
+
+  // objects keep the order of their members, and the keys of a document are stored once
+  assert_equal(json(R"({"z": 1, "a": 2, "m": {"y": 3, "b": 4}})").dump(), R"({"z":1,"a":2,"m":{"y":3,"b":4}})");
+  auto &song0=j7["result"]["songs"][0].get_const_object(), &song1=j7["result"]["songs"][1].get_const_object();
+  assert_equal(song0.begin()->first.view(), "id");
+  assert(song0.begin()->first.data()==song1.begin()->first.data());
+  assert_equal(json(R"({"a": 1, "b": 2, "a": 3})")["a"].operator int(), 1); // duplicate keys: the first one stays
+  std::string wide="{";
+  for(int i=0;i<100;++i) wide+=std::format("{}\"k{}\": {}", i? ", ": "", i, i);
+  wide+="}";
+  json w(wide);
+  assert_equal(w.get_const_object().size(), 100u);
+  assert_equal(w["k77"].operator int(), 77);
+  assert(w.find("/k100")==nullptr);
+  json wcopy=w;
+  wcopy.insert("extra", json("[1]"));
+  assert_equal(wcopy["k99"].operator int(), 99);
+  assert_equal(wcopy["extra"][0].operator int(), 1);
+  assert_equal(w.get_const_object().size(), 100u);
+
+  // retained sources: unchanged values are copied from the input
+  {
+    std::string text=R"({"a": [1, 2.50, {"x": "y"}], "b": {"c": 1e2}, "d": "s\u0041"})";
+    document doc(text, {.retain=true});
+    assert_equal(doc.dump(), text);
+    assert_equal(std::as_const(doc)["a"][1].source(), "2.50"); // const access changes nothing
+    assert_equal(doc.dump(), text);
+    assert_equal(doc.dump(2).find("2.5")!=std::string::npos, true); // pretty printing writes everything again
+    doc["b"]["c"]=3;
+    assert_equal(doc.dump(), R"({"a":[1, 2.50, {"x": "y"}],"b":{"c":3},"d":"s\u0041"})");
+    doc.at("/a/2/x")=std::string("z");
+    assert_equal(doc.dump(), R"({"a":[1,2.50,{"x":"z"}],"b":{"c":3},"d":"s\u0041"})");
+    assert_equal(doc.source(), "");
+    auto copy=std::as_const(doc)["d"];
+    assert_equal(copy.source(), R"("s\u0041")");
+    assert_equal(json(text)["a"].source(), ""); // not retained
+    // what the lenient parser made up is written again, and so is every container around it
+    for(auto lenient: {"[abc, tx, 01]", R"({"a": [1 2], "b": {"c" 1}, "d": "\q"})", "[1,]", "[1:2]", R"({"a":})"}){
+      document made_up(std::string(lenient), {.retain=true});
+      assert_equal(made_up.dump(), json(lenient).dump());
+      assert(validate(made_up.dump()));
+    }
+    document partly(std::string(R"({"ok": [1, 2.50], "bad": [tru]})"), {.retain=true});
+    assert_equal(partly.dump(), R"({"ok":[1, 2.50],"bad":[true]})");
+  }
+
+  // validation: the whole grammar and utf-8, with the offset of the first error
+  {
+    for(auto ok: {"0", "-0.5e+3", " [1, true, false, null, \"\\u00e9\\n\"] ", R"({"a": {"b": []}, "c": "\u00e9\u4e2d"})", "\"\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\""})
+      assert(validate(ok));
+    std::pair<const char *, size_t> bad[]={
+      {"", 0}, {"tru", 0}, {"[t]", 1}, {"nul ", 0}, {"01", 1}, {"1.", 2}, {"-", 1}, {"1e", 2}, {"+1", 0},
+      {"[1,]", 3}, {"{\"a\":1,}", 7}, {"{\"a\" 1}", 5}, {"{1: 2}", 1}, {"[1 2]", 3}, {"[1}", 2}, {"]", 0},
+      {"\"abc", 0}, {"[\"a\tb\"]", 3}, {"\"\\x\"", 2}, {"\"\\u12g4\"", 2}, {"{} {}", 3}, {"[\"\xc3(\"]", 2},
+      {"\"\xed\xa0\x80\"", 1}, {"\"\xc0\xaf\"", 1}, {"\"\xf4\x90\x80\x80\"", 1}, {"\"\xe4\xb8\"", 1}
+    };
+    for(auto [text, at]: bad){
+      auto v=validate(text);
+      assert(!v);
+      assert_equal(v.offset, at);
+    }
+    assert(validate("[[[1]]]", 3) && !validate("[[[[1]]]]", 3));
+    // a number over two blocks, and one ending the input with its block
+    assert(validate("["+std::string(60, ' ')+"12.25e3]"));
+    assert_equal(validate("["+std::string(60, ' ')+"12.2.5]").offset, 65u);
+    assert(validate(std::string(62, ' ')+"-0"));
+    auto edge=validate(std::string(61, ' ')+"-01");
+    assert(!edge);
+    assert_equal(edge.offset, 63u);
+    // every kernel finds the same first error, whatever the block it falls in
+    std::string big;
+    for(int i=0;i<200;++i) big+=std::format("{}{{\"k\\\\{}\": [\"\xe2\x82\xac{}\", -{}.5e1, null]}}", i? ",": "[", i, i, i);
+    big+="]";
+    assert(validate(big));
+    uint32_t seed=7;
+    for(int round=0;round<300;++round){
+      seed=seed*1103515245+12345;
+      auto broken=big;
+      broken[seed%broken.size()]="\x80\xe2\"\\,]} \x01"[seed>>16 & 7];
+      auto expect=parser::validate(broken, 1024, parser::kernel::scalar);
+      assert_equal(parser::utf8_error(broken, parser::kernel::scalar), parser::utf8_error(broken));
+      for(auto k: {parser::kernel::sse2, parser::kernel::avx2}) if(parser::supported(k)){
+        auto v=parser::validate(broken, 1024, k);
+        assert(bool(v)==bool(expect) && v.offset==expect.offset);
+      }
+    }
+    // strict parsing throws where the lenient one guesses
+    assert_equal(json("[tru]")[0].operator bool(), true);
+    bool thrown=false;
+    try{
+      auto raw=std::string_view("[tru]");
+      parser::parse(raw, {.strict=true});
+    }catch(std::invalid_argument &e){
+      thrown=std::string_view(e.what())=="invalid json: invalid literal at byte 1";
+    }
+    assert(thrown);
+    document strict(std::string(R"({"a": [1, 2]})"), {.strict=true});
+    assert_equal(strict["a"][1].operator int(), 2);
+  }
+
+  // building in place: braced lists, rvalue inserts, emplace and the builder move the values instead of copying them
+  {
+    std::string long_text(40, 'x');
+    json inner{{"text", json(array_t())}};
+    inner["text"].push_back(json(1));
+    auto *buf=inner["text"].get_const_array().data();
+    json outer{{"inner", std::move(inner)}, {"n", 2u}};
+    assert(outer["inner"]["text"].get_const_array().data()==buf); // moved all the way, not copied
+    assert_equal(outer["n"].is_unsigned(), false);
+    json arr=array_t();
+    arr.emplace_back(long_text);
+    arr.emplace_back();
+    arr.push_back(json{{"k", 1}});
+    assert_equal(arr.dump(), std::format(R"(["{}",{{}},{{"k":1}}])", long_text)); // a default json is an empty object
+    json obj=object_t();
+    obj.emplace("s", "text").get<std::string>()+="!";
+    assert_equal(obj.emplace("s", 5).to_string(), "text!"); // an existing member stays
+    obj.insert("a", std::move(arr));
+    assert_equal(obj["a"][2]["k"].operator int(), 1);
+    {
+      std::string tmp=long_text;
+      auto &v=obj.emplace("view", std::string_view(tmp));
+      assert(v.is_string() && v.to_string_view().data()!=tmp.data()); // a string_view is copied, like the builder does
+      arr=array_t();
+      arr.emplace_back(std::string_view(tmp));
+      assert(arr[0].to_string_view().data()!=tmp.data());
+    }
+    assert_equal(obj["view"].to_string(), long_text);
+    builder b;
+    b.begin_object().key("id").value(7).key("name").value(std::string_view(long_text))
+      .key("tags").begin_array().reserve(2).value("a").value(nullptr).end_array()
+      .key("owner").begin_object().key("ok").value(true).end_object().key("id").value(8).end_object();
+    assert(b.done());
+    assert_equal(b.result().dump(), std::format(R"({{"id":8,"name":"{}","tags":["a",null],"owner":{{"ok":true}}}})", long_text));
+    bool thrown=false;
+    try{
+      builder bad;
+      bad.begin_array().end_object();
+    }catch(std::logic_error &){
+      thrown=true;
+    }
+    assert(thrown);
+  }
+
+  // escapes are decoded once, when parsing, and written back by the writer
+  {
+    std::string text=R"(["a\"b\\c\/\né😀\ud800x", "plain", {"kA": 1}])";
+    json j(text);
+    auto decoded="a\"b\\c/\n\xc3\xa9\xf0\x9f\x98\x80\xef\xbf\xbdx";
+    assert_equal(j[0].to_string(), decoded);
+    assert_equal(j[0].to_string_view(), std::string_view(decoded));
+    assert_equal(j[2]["kA"].operator int(), 1);
+    assert_equal(j.dump(), "[\"a\\\"b\\\\c/\\n\xc3\xa9\xf0\x9f\x98\x80\xef\xbf\xbdx\",\"plain\",{\"kA\":1}]");
+    assert_equal(json(j.dump())[0].to_string(), decoded);
+    document borrowed(std::string_view(text), nullptr);
+    assert(std::as_const(borrowed)[1].to_string_view().data()==text.data()+text.find("plain")); // still a view into the input
+    assert_equal(std::as_const(borrowed)[0].to_string_view(), std::string_view(decoded));
+    std::pmr::monotonic_buffer_resource arena;
+    document in_arena(text, &arena);
+    assert_equal(std::as_const(in_arena)[0].to_string_view(), std::string_view(decoded));
+    std::string long_escaped="\"";
+    for(int i=0;i<40;++i) long_escaped+=std::format("segment {} \\t\\u4e2d", i);
+    long_escaped+="\"";
+    auto long_decoded=json(long_escaped).to_string();
+    assert_equal(long_decoded.size(), 590u);
+    assert_equal(long_decoded.substr(0, 14), "segment 0 \t\xe4\xb8\xad");
+    assert_equal(parser::unescape(R"(\q\u12\)"), "qu12\\"); // leniently, the character after the backslash
+  }
+
+  // nesting is bounded, and read without recursion
+  {
+    std::string deep(5000, '[');
+    deep+=std::string(5000, ']');
+    bool thrown=false;
+    try{
+      json j(deep);
+    }catch(std::invalid_argument &e){
+      thrown=std::string_view(e.what())=="invalid json: nesting too deep at byte 1024";
+    }
+    assert(thrown);
+    std::string_view raw=deep;
+    auto j=parser::parse(raw, {.max_depth=5000});
+    assert_equal(j[0][0][0].get_const_array().size(), 1u);
+    raw=deep;
+    assert_equal(parser::parse(raw, {.strict=true, .max_depth=5000}).get_const_array().size(), 1u); // past the inline bit set
+    assert(validate(deep, 5000) && !validate(deep, 4999));
+    assert(!validate(deep.substr(0, 4500)+"}"+deep.substr(4501), 5000)); // a mismatch deeper than 4096
+    std::string_view stray=R"([1,:2, }])";
+    assert_equal(parser::parse(stray).dump(), "[1,{},2]"); // leniently, and it ends
+  }
+
+  // stats of one parse
+  {
+    parser::stats st;
+    std::string_view raw=R"({"a": [1, 2.5, "three", true, null], "b": {"c": "a long string, past the inline buffer"}, "a2": x} tail)";
+    auto j=parser::parse(raw, {.stats=&st});
+    assert_equal(j["b"]["c"].to_string(), "a long string, past the inline buffer");
+    assert_equal(st.bytes, 99u);
+    assert_equal(raw, std::string_view("tail"));
+    assert_equal(st.objects, 2u);
+    assert_equal(st.arrays, 1u);
+    assert_equal(st.strings, 3u);
+    assert_equal(st.numbers, 2u);
+    assert_equal(st.booleans, 1u);
+    assert_equal(st.nulls, 1u);
+    assert_equal(st.max_depth, 2u);
+    assert_equal(st.allocations, 9u); // the index, 3 containers, 4 keys, 1 string
+    assert(st.validate.count()==0 && st.build.count()>0);
+  }
+  // a string longer than the inline buffer of std::string is an allocation, one that fits is not
+  for(auto [text, allocations]: {std::pair{R"(["twenty characters!!"])", 3u}, {R"(["short"])", 2u}}){
+    parser::stats st;
+    std::string_view raw=text;
+    parser::parse(raw, {.stats=&st});
+    assert_equal(st.allocations, allocations); // the index and the array, the string when past the inline buffer
+  }
+
   return 0;
 }catch(xihale::json::exception &e){
   std::cerr<<e.what()<<std::endl;
@@ -0,0 +1,109 @@
+#include <json_bind.hpp>
+#include <format>
+#include <string>
+#include <source_location>
+#include <iostream>
+#include <assert.h>
+#include <string_view>
+
+using namespace xihale::json;
+
+template<typename T, typename U>
+void assert_equal(const T &a, const U &b, const std::source_location loc=std::source_location::current()){
+  if(a!=b){
+    std::cerr<<std::format("Line {} Column {}: {} != {}\n", loc.line(), loc.column(), a, b);
+  }
+}
+
+struct artist{
+  long long id=0;
+  std::string name{};
+  std::vector<std::string> alias{};
+};
+XJSON_BIND(artist, id, name, alias);
+
+struct song{
+  unsigned long long id=0;
+  std::string name{};
+  std::vector<artist> artists{};
+  std::optional<double> score{};
+  std::map<std::string, int> tags{};
+  bool liked=false;
+  json extra{};
+};
+XJSON_BIND(song, id, name, artists, score, tags, liked, extra);
+
+// json names other than the member names
+struct point{
+  float x=0, y=0;
+};
+
+template<>
+struct xihale::json::json_traits<point>{
+  static constexpr std::tuple members{bind::member("X", &point::x), bind::member("Y", &point::y)};
+};
+
+struct empty{};
+XJSON_BIND(empty);
+
+template<typename T>
+bool fails(std::string_view raw){
+  try{
+    bind::parse<T>(raw);
+  }catch(const std::invalid_argument &){
+    return true;
+  }
+  return false;
+}
+
+int main(){
+
+  auto s=bind::parse<song>(R"({
+    "id": 22645196, "name": "Bad \"Apple\"!!", "unknown": {"skipped": [1, {"x": "]"}]},
+    "artists": [{"id": 1, "name": "ZUN", "alias": ["神主"]}, {"name": "nomico", "alias": []}],
+    "score": 9.5, "tags": {"touhou": 1, "remix": 2}, "liked": true, "extra": {"year": 2009}
+  })");
+  assert_equal(s.id, 22645196u);
+  assert_equal(s.name, "Bad \"Apple\"!!");
+  assert_equal(s.artists.size(), 2u);
+  assert_equal(s.artists[0].alias[0], "神主");
+  assert_equal(s.artists[1].id, 0); // missing: left as it was
+  assert_equal(*s.score, 9.5);
+  assert_equal(s.tags["remix"], 2);
+  assert(s.liked);
+  assert_equal(int(s.extra["year"]), 2009);
+
+  // written back in member order, then read again
+  auto text=bind::dump(s);
+  assert_equal(text, R"({"id":22645196,"name":"Bad \"Apple\"!!","artists":[{"id":1,"name":"ZUN","alias":["神主"]},)"
+    R"({"id":0,"name":"nomico","alias":[]}],"score":9.5,"tags":{"remix":2,"touhou":1},"liked":true,"extra":{"year":2009}})");
+  assert_equal(bind::dump(bind::parse<song>(text)), text);
+  assert_equal(bind::dump(bind::parse<song>(R"({"score": null})")).find(R"("score":null)")!=std::string::npos, true);
+
+  auto p=bind::parse<point>(R"({"Y": 2, "X": 1.5, "x": 9})");
+  assert_equal(p.x, 1.5f);
+  assert_equal(p.y, 2.0f);
+  assert_equal(bind::dump(p), R"({"X":1.5,"Y":2.0})");
+  assert_equal(bind::dump(bind::parse<empty>(R"({"a": 1})")), "{}");
+
+  // containers and scalars at the top level
+  assert_equal(bind::parse<std::vector<int>>("[1, 2, 3]").size(), 3u);
+  assert_equal(bind::parse<std::vector<int>>(" [] ").size(), 0u);
+  assert_equal(bind::parse<std::string>(R"("a\tb")"), "a\tb");
+  assert_equal(bind::parse<std::string_view>(R"("borrowed")"), "borrowed");
+  assert_equal(bind::dump(std::vector<std::optional<int>>{1, std::nullopt}, 0), "[1,null]");
+  auto huge=bind::parse<std::vector<double>>("[1e400, -1e400, 1e-400]");
+  assert(huge.size()==3 && huge[0]==HUGE_VAL && huge[1]==-HUGE_VAL && huge[2]==0.0);
+
+  // bad input
+  assert(fails<song>(R"({"id": -1})")); // out of range
+  assert(fails<song>(R"({"id": 1.5})"));
+  assert(fails<song>(R"({"name": 1})"));
+  assert(fails<song>(R"({"liked": "yes"})"));
+  assert(fails<song>(R"({"artists": [{"id": 1}})"));
+  assert(fails<song>(R"({"id": 1} x)"));
+  assert(fails<std::vector<signed char>>("[127, 128]"));
+  assert(fails<std::string_view>(R"("a\nb")"));
+
+  return 0;
+}
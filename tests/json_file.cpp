@@ -0,0 +1,79 @@
+#include <json_file.hpp>
+#include <json_ondemand.hpp>
+#include <format>
+#include <fstream>
+#include <string>
+#include <source_location>
+#include <iostream>
+#include <assert.h>
+#include <string_view>
+#include <unistd.h>
+
+using namespace xihale::json;
+
+template<typename T, typename U>
+void assert_equal(const T &a, const U &b, const std::source_location loc=std::source_location::current()){
+  if(a!=b){
+    std::cerr<<std::format("Line {} Column {}: {} != {}\n", loc.line(), loc.column(), a, b);
+  }
+}
+
+int main(){
+
+  auto path=std::format("/tmp/xjson_file_test_{}.json", ::getpid());
+  {
+    std::ofstream out(path, std::ios::binary);
+    out<<R"({"name": "Bad Apple!!", "list": [1, 2.5, "three"], "nested": {"x": null}})";
+  }
+
+  {
+    mapped_file file(path);
+    assert_equal(file.view().front(), '{');
+    assert_equal(file.view().back(), '}');
+    // the padding after the end is readable
+    for(size_t i=0;i<mapped_file::padding;++i) assert_equal(int(file.view().data()[file.size()+i]), 0);
+    assert_equal(ondemand::document(file.view())["list"][2].get_string(), "three");
+  }
+
+  document copy;
+  {
+    auto doc=parse_file(path);
+    assert_equal(doc["name"].to_string(), "Bad Apple!!");
+    assert_equal(doc["list"][1].operator double(), 2.5);
+    copy=doc;
+    // retained: written back from the mapping
+    assert_equal(parse_file(path, {.retain=true}).dump(), R"({"name": "Bad Apple!!", "list": [1, 2.5, "three"], "nested": {"x": null}})");
+  }
+  std::remove(path.c_str());
+
+  // the copy keeps the mapping alive
+  assert_equal(copy["list"][2].to_string(), "three");
+  assert(copy["nested"]["x"].is_null());
+
+  {
+    std::ofstream out(path);
+  }
+  // an empty file maps nothing but the padding
+  assert_equal(mapped_file(path).view().size(), 0u);
+  parse_file(path);
+  std::remove(path.c_str());
+
+  // a pipe has no size to map: it is read to its end
+  int fds[2];
+  assert(::pipe(fds)==0);
+  std::string_view piped=R"({"piped": [1, 2, 3]})";
+  assert(::write(fds[1], piped.data(), piped.size())==ssize_t(piped.size()));
+  ::close(fds[1]);
+  {
+    auto doc=parse_file(std::format("/dev/fd/{}", fds[0]));
+    assert_equal(doc["piped"][2].operator int(), 3);
+  }
+  ::close(fds[0]);
+
+  try{
+    parse_file(path);
+    assert(false);
+  }catch(std::system_error &){}
+
+  return 0;
+}
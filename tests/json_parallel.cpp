@@ -0,0 +1,81 @@
+#include <json_parallel.hpp>
+#include <format>
+#include <string>
+#include <source_location>
+#include <iostream>
+#include <assert.h>
+#include <string_view>
+
+using namespace xihale::json;
+
+template<typename T, typename U>
+void assert_equal(const T &a, const U &b, const std::source_location loc=std::source_location::current()){
+  if(a!=b){
+    std::cerr<<std::format("Line {} Column {}: {} != {}\n", loc.line(), loc.column(), a, b);
+  }
+}
+
+int main(){
+
+  // newline delimited, concatenated and pretty printed documents may be mixed
+  auto docs=parallel::split("{\"a\": 1}\n[1, \"x]\"]\n\n  \"str\" 12 {\n \"b\": {}\n}");
+  assert_equal(docs.size(), 5u);
+  assert_equal(docs[1], std::string_view("[1, \"x]\"]"));
+  assert_equal(docs[3], std::string_view("12"));
+  assert_equal(docs[4], std::string_view("{\n \"b\": {}\n}"));
+
+  std::string ndjson;
+  for(int i=0;i<1000;++i) ndjson+=std::format("{{\"id\": {}, \"name\": \"user {}\", \"tags\": [{}, {}]}}\n", i, i, i, i+1);
+
+  for(size_t threads: {1, 2, 4}){
+    parallel::pool workers(threads);
+    assert_equal(workers.size(), threads);
+
+    // delivered in the order of the input, whatever the order they were parsed in
+    int expect=0;
+    parallel::parse_many(ndjson, workers, [&](json &&j){
+      assert_equal(j["id"].operator int(), expect);
+      assert_equal(j["tags"][1].operator int(), expect+1);
+      ++expect;
+    }, 7);
+    assert_equal(expect, 1000);
+
+    auto all=parallel::parse_many(ndjson, workers);
+    assert_equal(all.size(), 1000u);
+    assert_equal(all[999]["name"].to_string(), "user 999");
+    auto batched=parallel::parse_many(ndjson, workers, 16);
+    assert_equal(batched.size(), 1000u);
+    assert_equal(batched[500]["id"].operator int(), 500);
+  }
+
+  // an exception in the callback leaves no task behind
+  parallel::pool workers(2);
+  try{
+    parallel::parse_many(ndjson, workers, [&](json &&j){
+      if(j["id"].operator int()==10) throw std::runtime_error("stop");
+    }, 3);
+    assert(false);
+  }catch(std::runtime_error &){}
+
+  // a top level array, cut anywhere: inside strings, escapes and nested containers
+  std::string arr="[";
+  for(int i=0;i<300;++i){
+    if(i) arr+=", ";
+    arr+=std::format("{{\"id\": {}, \"s\": \"a,b]\\\\\", \"q\": \"\\\"[\", \"n\": [[{}], {{}}, \"]\"]}}", i, i);
+  }
+  arr+="] ";
+  json whole(arr);
+  for(size_t chunk: {1, 2, 3, 7, 64, 100, 1000, 1<<20}){
+    auto split_up=parallel::parse_array(arr, workers, chunk);
+    assert_equal(split_up.get_array().size(), 300u);
+    for(size_t k: {0, 1, 150, 299}) assert_equal(split_up[k].to_string(), whole[k].to_string());
+    assert_equal(split_up[299]["s"].to_string(), "a,b]\\");
+    assert_equal(split_up[299]["n"][2].to_string(), "]");
+  }
+  assert_equal(parallel::parse_array("[]", workers).get_array().size(), 0u);
+  assert_equal(parallel::parse_array(" [ ] ", workers, 1).get_array().size(), 0u);
+  assert_equal(parallel::parse_array("[1, [2, 3]]", workers, 1)[1][1].operator int(), 3);
+  assert_equal(parallel::parse_array("{\"a\": [1]}", workers)["a"][0].operator int(), 1);
+
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include <json_shared.hpp>
+#include <format>
+#include <string>
+#include <source_location>
+#include <iostream>
+#include <assert.h>
+#include <string_view>
+#include <thread>
+
+using namespace xihale::json;
+
+template<typename T, typename U>
+void assert_equal(const T &a, const U &b, const std::source_location loc=std::source_location::current()){
+  if(a!=b){
+    std::cerr<<std::format("Line {} Column {}: {} != {}\n", loc.line(), loc.column(), a, b);
+  }
+}
+
+int main(){
+
+  json config(R"({"name": "svc", "limits": {"cpu": 2, "mem": 1.5}, "hosts": ["a", "b"], "big": 18446744073709551615})");
+  shared::document v1(config);
+  assert_equal(v1.dump(), config.dump());
+  assert_equal((*v1)["limits"]["cpu"].operator int(), 2);
+  assert_equal((*v1)["limits"]["mem"].operator double(), 1.5);
+  assert_equal((*v1)["hosts"][1].to_string_view(), std::string_view("b"));
+  assert_equal(v1->find("/big")->operator unsigned long long(), 18446744073709551615ull);
+  assert(v1->find("/hosts/5")==nullptr);
+
+  // a change copies the path to it, everything else is shared
+  auto v2=v1.set("/limits/cpu", json(4));
+  assert_equal((*v2)["limits"]["cpu"].operator int(), 4);
+  assert_equal((*v1)["limits"]["cpu"].operator int(), 2);
+  assert(&(*v2)["hosts"]==&(*v1)["hosts"]);
+  assert(&(*v2)["limits"]!=&(*v1)["limits"]);
+  auto v3=v2.set("/hosts/-", json(R"("c")")).set("/limits/disk", json(10)).erase("/name");
+  assert_equal(v3.dump(), R"({"limits":{"cpu":4,"mem":1.5,"disk":10},"hosts":["a","b","c"],"big":18446744073709551615})");
+  assert_equal(v1.dump(), config.dump());
+  assert_equal(v3.to_json()["hosts"][2].to_string(), "c");
+  bool thrown=false;
+  try{
+    v1.set("/missing/x", json(1));
+  }catch(std::out_of_range &){
+    thrown=true;
+  }
+  assert(thrown);
+
+  // big objects are indexed
+  json wide=object_t();
+  for(int i=0;i<100;++i) wide.insert(std::format("k{}", i), json(i));
+  shared::document w(wide);
+  assert_equal((*w)["k73"].operator int(), 73);
+  assert_equal((*w.set("/k10", json(-1)))["k10"].operator int(), -1);
+
+  // readers keep their snapshot while writers publish new versions
+  shared::publisher pub(v1);
+  std::vector<std::thread> readers;
+  std::atomic<bool> bad{false};
+  for(int t=0;t<4;++t)
+    readers.emplace_back([&]{
+      for(int i=0;i<2000;++i){
+        auto snap=pub.load();
+        long long cpu=(*snap)["limits"]["cpu"];
+        if(cpu<2 || (*snap)["hosts"].size()!=2) bad=true;
+      }
+    });
+  for(int i=0;i<200;++i)
+    pub.update([](const shared::document &d){
+      return d.set("/limits/cpu", json((long long)((*d)["limits"]["cpu"])+1));
+    });
+  for(auto &r: readers) r.join();
+  assert(!bad);
+  assert_equal((*pub.load())["limits"]["cpu"].operator int(), 202);
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <json_stream.hpp>
+#include <format>
+#include <string>
+#include <source_location>
+#include <iostream>
+#include <sstream>
+#include <assert.h>
+#include <string_view>
+
+using namespace xihale::json;
+
+template<typename T, typename U>
+void assert_equal(const T &a, const U &b, const std::source_location loc=std::source_location::current()){
+  if(a!=b){
+    std::cerr<<std::format("Line {} Column {}: {} != {}\n", loc.line(), loc.column(), a, b);
+  }
+}
+
+// records the events as text
+struct recorder{
+  std::string out{};
+  void start_object(){ out+="{"; }
+  void end_object(){ out+="}"; }
+  void start_array(){ out+="["; }
+  void end_array(){ out+="]"; }
+  void key(std::string_view k){ out+=std::format("k:{} ", k); }
+  void string(std::string_view s){ out+=std::format("s:{} ", s); }
+  void number(long long i){ out+=std::format("i:{} ", i); }
+  void number(double d){ out+=std::format("d:{} ", d); }
+  void boolean(bool b){ out+=b? "true ": "false "; }
+  void null(){ out+="null "; }
+};
+
+int main(){
+
+  std::string doc=R"( {"name": "Bad \"Apple\"!!", "id": 22645196, "pi": 3.25,
+    "tags": [true, false, null, [], {}], "nested": {"a": [1, {"b": "\\"}]}} )";
+
+  recorder whole;
+  stream::push_parser p(whole);
+  p.feed(doc);
+  p.finish();
+  assert(p.done());
+  assert_equal(whole.out, R"({k:name s:Bad \"Apple\"!! k:id i:22645196 k:pi d:3.25 k:tags [true false null []{}]k:nested {k:a [i:1 {k:b s:\\ }]}})");
+
+  // the same events whatever the chunking, even inside strings, escapes, numbers and literals
+  for(size_t size: {1, 2, 3, 7, 16}){
+    recorder cut;
+    stream::push_parser q(cut);
+    for(size_t i=0;i<doc.size();i+=size) q.feed(std::string_view(doc).substr(i, size));
+    q.finish();
+    assert_equal(cut.out, whole.out);
+  }
+
+  // a number at the very end is only complete at finish()
+  recorder num;
+  stream::push_parser pn(num);
+  pn.feed("12");
+  pn.feed("34");
+  assert(!pn.done());
+  pn.finish();
+  assert_equal(num.out, "i:1234 ");
+
+  auto rejects=[](std::string_view raw, size_t depth=1024){
+    recorder r;
+    stream::push_parser bad(r, depth);
+    try{
+      bad.feed(raw);
+      bad.finish();
+    }catch(std::invalid_argument &){
+      return true;
+    }
+    return false;
+  };
+  assert(rejects("[1, 2,]"));
+  assert(rejects(R"({"a" 1})"));
+  assert(rejects("[1, 2"));
+  assert(rejects("tru"));
+  assert(rejects("[1] 2"));
+  assert(rejects("[[[[1]]]]", 3));
+  assert(!rejects("[[[1]]]", 3));
+
+  // the dom builder on top of the events
+  std::istringstream in(doc);
+  json j=stream::parse(in, 5);
+  assert_equal(j["id"].operator int(), 22645196);
+  assert_equal(j["name"].to_string(), "Bad \"Apple\"!!");
+  assert_equal(j["nested"]["a"][1]["b"].to_string(), "\\");
+  assert(j["tags"][2].is_null());
+  assert(j["tags"][4].is_object());
+
+  // negatives and exponents are doubles, integers above the range of long long come as doubles without number(unsigned long long)
+  recorder nums;
+  stream::push_parser np(nums);
+  np.feed("[-3.5e2, -12, 18446744073709551615]");
+  np.finish();
+  assert_equal(nums.out, "[d:-350 i:-12 d:1.8446744073709552e+19 ]");
+
+  // past the range of a double: infinite or zero
+  recorder huge;
+  stream::push_parser hp(huge);
+  hp.feed("[1e400, -1e400, 1e-400]");
+  hp.finish();
+  assert_equal(huge.out, "[d:inf d:-inf d:0 ]");
+
+  return 0;
+}
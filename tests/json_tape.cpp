@@ -0,0 +1,106 @@
+#include <json_tape.hpp>
+#include <format>
+#include <string>
+#include <source_location>
+#include <iostream>
+#include <assert.h>
+#include <string_view>
+
+using namespace xihale::json;
+
+template<typename T, typename U>
+void assert_equal(const T &a, const U &b, const std::source_location loc=std::source_location::current()){
+  if(a!=b){
+    std::cerr<<std::format("Line {} Column {}: {} != {}\n", loc.line(), loc.column(), a, b);
+  }
+}
+
+int main(){
+
+  tape t(R"({"id": 22645196, "name": "Bad Apple!!", "score": 1.5, "ok": true, "none": null,
+    "artists": [{"id": 17423, "name": "のみこ", "alias": []}, {"id": 2, "name": "a\"b"}]})");
+  auto root=t.root();
+
+  assert(root.is_object());
+  assert_equal(root.size(), 6u);
+  assert_equal(int(root["id"]), 22645196);
+  assert_equal(root["name"].to_string(), "Bad Apple!!");
+  assert_equal(double(root["score"]), 1.5);
+  assert(bool(root["ok"]));
+  assert(root["none"].is_null());
+  assert(!root.find("missing"));
+
+  auto artists=root["artists"];
+  assert(artists.is_array());
+  assert_equal(artists.size(), 2u);
+  assert_equal(artists[0]["name"].to_string(), "のみこ");
+  assert_equal(artists[0]["alias"].size(), 0u);
+  assert_equal(artists[1]["name"].to_string(), "a\"b");
+  assert_equal(artists[1]["name"].to_string_view(), std::string_view("a\\\"b"));
+
+  std::string keys;
+  for(auto it=root.begin();it!=root.end();++it) keys+=std::string(it->key())+",";
+  assert_equal(keys, "id,name,score,ok,none,artists,");
+
+  int ids=0;
+  for(auto artist: artists) ids+=int(artist["id"]);
+  assert_equal(ids, 17425);
+
+  assert_equal(artists[1].to_string(), R"({"id":2,"name":"a\"b"})");
+
+  // to and from the mutable json
+  json j=root.to_json();
+  assert_equal(j["artists"][0]["name"].to_string(), "のみこ");
+  assert_equal(j["id"].operator int(), 22645196);
+
+  tape back(j);
+  assert_equal(int(back.root()["artists"][1]["id"]), 2);
+  assert_equal(back.root()["name"].to_string(), "Bad Apple!!");
+  assert(back.memory()<=t.memory()+64);
+
+  tape scalar("123");
+  assert_equal(int(scalar.root()), 123);
+
+  tape nums("[-7, 18446744073709551615, 0.5]");
+  assert_equal(int(nums.root()[0]), -7);
+  assert(nums.root()[1].is_integer());
+  assert_equal((unsigned long long)(nums.root()[1]), 18446744073709551615ull);
+  assert_equal(nums.root().to_string(), "[-7,18446744073709551615,0.5]");
+
+  // the tape keeps strings escaped, a json keeps them decoded: each way converts
+  json decoded=object_t();
+  decoded.emplace("k\"ey", "a\nb\\c");
+  tape from_json(decoded);
+  assert_equal(from_json.root().to_string(), R"({"k\"ey":"a\nb\\c"})");
+  assert_equal(from_json.root()["k\"ey"].to_string(), "a\nb\\c");
+  tape escaped(R"({"k\"ey": "a\nb\\c", "é": 1})");
+  assert_equal(escaped.root().to_json().dump(), R"({"k\"ey":"a\nb\\c","é":1})");
+  assert_equal(escaped.root()["k\"ey"].to_string(), "a\nb\\c");
+  assert_equal(int(escaped.root()["é"]), 1);
+  assert_equal(tape(escaped.root().to_json()).root().to_string(), escaped.root().to_string());
+
+  // stray delimiters are skipped the way the parser skips them, a missing value is null
+  assert_equal(tape("[:]").root().to_string(), "[null]");
+  assert_equal(tape("[}").root().to_string(), "[]");
+  assert_equal(tape("[1:2]").root().to_string(), "[1,2]");
+  assert_equal(tape("[1:2]").root().size(), 2u);
+  assert_equal(tape("[,]").root().to_string(), "[null]");
+  assert_equal(tape(R"({"a" 1, "b": [1 2}})").root().to_string(), R"({"a":1,"b":[1,2]})");
+
+  // nesting deeper than max_depth is rejected, not recursed into
+  std::string deep(1000000, '[');
+  bool threw=false;
+  try{ tape{deep}; }catch(std::invalid_argument &){ threw=true; }
+  assert(threw);
+  assert_equal(tape(std::string(8, '[')+std::string(8, ']'), 8).root()[0][0].size(), 1u);
+  threw=false;
+  try{ tape(std::string(9, '[')+std::string(9, ']'), 8); }catch(std::invalid_argument &){ threw=true; }
+  assert(threw);
+  json nested=array_t();
+  for(int i=0;i<8;++i) nested=array_t{std::move(nested)};
+  threw=false;
+  try{ tape(nested, 8); }catch(std::invalid_argument &){ threw=true; }
+  assert(threw && tape(nested, 9).root().size()==1);
+
+  return 0;
+}